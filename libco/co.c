@@ -1,19 +1,30 @@
+#define _GNU_SOURCE
 #include <assert.h>
-#include <setjmp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
 
 #include "co.h"
 
-// #define DEBUG
-#ifdef DEBUG
-  #include <stdio.h>
-  #define debug(format, ...) printf(format, __VA_ARGS__)
-#else
-  #define debug(format, ...) 
-#endif
+// #define SCHED_RANDOM  // pick a random ready coroutine instead of FIFO
+
+// count an event of worker w, see co_stats()
+#define stat_inc(w, field) \
+  do { if (__builtin_expect(co_stats_on, 0)) (w)->stats.field++; } while (0)
 
 
 // data structure
@@ -22,139 +33,1673 @@ enum co_status {
   CO_NEW,       // not loaded
   CO_RUNNING,   // loaded && running
   CO_WAITING,   // loaded && not running
+  CO_EXITING,   // finished && still switching out
   CO_DEAD,      // finished
 };
 
-#define STACK_SIZE 1 << 16
+#define STACK_SIZE (1 << 16) // default block: guard + stack + struct co
+#define GUARD_SIZE 4096      // PROT_NONE page below each stack
+#define MIN_SHIFT  13        // smallest block is 8 KiB
+#define NCLASS     16        // blocks of 8 KiB .. 256 MiB
+#define SLAB_SIZE  (1 << 20) // smaller blocks are carved from one mapping
 #define NAME_SIZE 64
+#define SHARED_CLS (-1)
+#define POLL_INTERVAL 64     // switches between non-blocking polls
+#define NEVENT 64            // epoll events fetched at once
+#define TICK_SHIFT 20        // timer resolution, about 1 ms
+#define WHEEL_BITS 6         // 64 slots per level
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 6       // 64^6 ticks, about two years
+#define SHARED_SIZE (1 << 23) // the shared stack, backed as it is touched
+#define STAT_NAMES 256       // co_stats_dump() groups up to this many names
+#define STACK_FILL 0xcdcdcdcdcdcdcdcdull // watermark of unused stack
+
+enum co_timer {
+  TIMER_NONE = 0,
+  TIMER_ARMED,  // on the wheel
+  TIMER_FIRED,  // taken off the wheel by co_poll(), which resumes us
+};
+
+// FIFO of parked coroutines, linked through co->next; always guarded by
+// the lock of the object it belongs to
+struct waitq {
+  struct co *head, *tail;
+};
+
 struct co {
   char name[NAME_SIZE];
   void (*func)(void *); // entry address and parameters
   void *arg;
 
   enum co_status status;
-  jmp_buf        context;
-  uint8_t        stack[STACK_SIZE];
-}; 
-/*** sizeof(co_pool[0]) should be a multiple of 16 ***/
-/*** This is for consistency of sp alignment ***/
+  struct co     *next;  // link in the ready queue, a waitq or the free list
+  struct waitq   waiters; // parked in co_wait() on us
+  int            nwait; // co_wait() calls in progress, the last one frees
+  int            lock;  // guards status and waiters under co_run()
+  struct co_group *group; // co_group_spawn() member, freed as it finishes
+  void          *sp;    // saved stack pointer, see co_swap()
+  uint8_t       *stack; // lowest address of the block (the guard page)
+  int            cls;   // size class, the block is 1 << (MIN_SHIFT + cls);
+                        // SHARED_CLS: runs on the shared stack instead
+  void          *save;  // shared stack: image of [sp, top) while evicted
+  size_t         save_cap;
+
+  // timer wheel slot, guarded by io.lock
+  enum co_timer  timer;
+  uint64_t       expires; // in ticks
+  struct co     *tnext, **tpprev;
+  struct co     *waiting_on; // co_wait_timeout() target
+
+  // co_stats_enable() only
+  uint64_t       nswitch; // times resumed
+  uint64_t       cycles;  // TSC cycles spent running
+  uint64_t       tsc;     // TSC when last resumed, 0 if unknown
+  int            filled;  // the stack is watermarked with STACK_FILL
+
+  // scheduling, see struct policy
+  int            prio;     // 0 .. CO_PRIO_MAX
+  uint64_t       vruntime; // CO_POLICY_FAIR: weighted TSC cycles run
+};
+
+// what co_finish() does with the coroutine we just switched away from
+enum prev_op {
+  PREV_NONE = 0,
+  PREV_READY,   // yielded: make it runnable again
+  PREV_PARK,    // blocked: it is on some waitq, release w->park_lock
+  PREV_DEAD,    // returned: its stack is unused now, publish CO_DEAD
+};
+
+// everything a thread needs to run coroutines: the single-threaded
+// runtime is w_main alone, co_run() adds one worker per thread
+struct worker {
+  struct co   *current;
+  struct co   *prev;    // the coroutine we just switched away from
+  enum prev_op prev_op;
+  int         *park_lock; // PREV_PARK: guards where prev is parked
+
+  // ready queue: every CO_NEW/CO_WAITING coroutine that may be picked,
+  // ordered by the policy of the runtime
+  enum co_policy policy;
+  struct {
+    struct co *head, *tail; // CO_POLICY_RR, linked through co->next
+    struct waitq prio[CO_PRIO_MAX + 1]; // CO_POLICY_PRIORITY
+    unsigned prio_mask;     // bit i: prio[i] is not empty
+    int len;
+    int lock;           // only taken under co_run()
+  } ready;
+  // CO_POLICY_FAIR: binary min-heap on co->vruntime, kept across runs
+  struct {
+    struct co **v;
+    int cap;
+    uint64_t min_vruntime; // of the last coroutine picked
+    uint64_t slice;        // TSC when current was resumed
+  } fair;
+
+  // one pool per size class: recycled coroutines linked through co->next,
+  // and the unused tail of the last slab
+  struct {
+    struct co *free;
+    uint8_t   *next, *end;
+  } pool[NCLASS];
+
+  // co_run() only
+  struct co   *idle;    // runs idle_loop() when ready is empty
+  void        *boot_sp; // the thread's own context, resumed at shutdown
+  pthread_t    thread;
+  unsigned     seed;
+  unsigned     nsched;  // scheduler() calls, paces co_poll()
+
+  struct co_stats stats; // co_stats_enable() only
+
+  // coroutines started with co_attr.shared_stack all run at the top of
+  // one stack; only the occupant's frames are there, the others wait
+  // in their save buffers (single-threaded runtime only)
+  struct {
+    uint8_t   *top;
+    struct co *occupant;
+    struct co *next;   // where copier is headed
+    struct co *copier; // swaps images, on a stack of its own
+    struct co *free;   // recycled, their struct co is malloc()ed
+  } shared;
+};
 
-#define NCO 128
-static struct co co_pool[NCO]; // a pool with NCO coroutines
-static struct co *current; 
-static int co_alive; 
+static struct co co_main;  // main runs on the process stack
+static struct worker w_main;
+static __thread struct worker *tls_worker
+  __attribute__((tls_model("initial-exec")));
+static int co_stats_on;
+
+// totals of finished coroutines by name, see co_stats_dump()
+static struct {
+  int lock;
+  struct {
+    char     name[NAME_SIZE];
+    uint64_t count, switches, cycles;
+    size_t   stack_peak;
+  } tab[STAT_NAMES];
+} co_names;
+
+// ring buffer of values; cap == 0 means unbounded and the ring grows
+struct co_chan {
+  int          lock;
+  int          closed;
+  size_t       cap;
+  size_t       size, head, len;
+  void       **buf;
+  struct waitq senders, receivers;
+};
+
+struct co_sem {
+  int          lock;
+  int          value;
+  struct waitq waiters;
+};
+
+// members still running, and who waits for them all
+struct co_group {
+  int          lock;
+  int          pending;
+  struct waitq waiters;
+};
+
+// what the reactor knows about one file descriptor
+struct co_fd {
+  int          lock;
+  int          registered; // O_NONBLOCK set and added to io.epfd
+  uint32_t     ready;      // edges that arrived while nobody waited
+  struct waitq rd, wr;
+};
+
+// the reactor: coroutines blocked on I/O or asleep are not runnable,
+// co_poll() makes them so; scheduler() drives it
+static struct {
+  int           lock;     // guards epfd creation and the wheel
+  int           epfd;     // created on first use
+  int           evfd;     // in epfd, so that idle_notify() can end a wait
+  struct co_fd *fds;      // indexed by fd, up to the hard RLIMIT_NOFILE
+  int           nfds;
+  int           nwait;    // coroutines parked on an fd
+
+  // hierarchical timer wheel: level k slot i holds the timers due in
+  // 64^k ticks or more whose expiry has bits i at level k, and is
+  // pushed down a level once tick reaches it; each slot is a list
+  // linked through co->tnext
+  uint64_t      tick;     // every timer before it has fired
+  int           ntimer;
+  struct co    *wheel[WHEEL_LEVELS][WHEEL_SIZE];
+} io;
+
+// A scheduling policy orders the ready queue of a worker. The hooks
+// run under w->ready.lock; the caller maintains w->ready.len.
+struct policy {
+  void (*push)(struct worker *w, struct co *co);
+  struct co *(*pop)(struct worker *w); // never called on an empty queue
+  // whether the yielding current coroutine beats every queued one
+  int (*keep)(struct worker *w, struct co *current);
+};
+
+// the M:N runtime, see co_run()
+static struct {
+  struct worker *workers;
+  int nworkers;   // 0 when single-threaded
+  int nalloc;
+  struct co *root;
+  int done;       // root has returned, workers should stop
+
+  // idle workers sleep on wake_seq, see idle_park(), except that while
+  // fds or timers are pending one of them waits in co_poll(1) instead
+  int nidle;      // workers asleep, or about to be
+  int wake_seq;   // bumped by every idle_wake()
+  struct worker *poller;
+} rt;
 
 // static function
-static inline void stack_switch_call(void *sp, void *entry);
-static void *wrapper();
-static void scheduler();
+static struct worker *this_worker() __attribute__((noipa));
+static inline void spin_lock(int *lock);
+static inline void spin_unlock(int *lock);
+static inline void ready_push(struct worker *w, struct co *co);
+static void ready_push_n(struct worker *w, struct co *head);
+static inline struct co *ready_pop(struct worker *w);
+static inline struct co *ready_take(struct worker *w);
+static struct co *ready_steal(struct worker *w);
+static int ready_keep(struct worker *w);
+static void rr_push(struct worker *w, struct co *co);
+static struct co *rr_pop(struct worker *w);
+static int rr_keep(struct worker *w, struct co *current);
+static void prio_push(struct worker *w, struct co *co);
+static struct co *prio_pop(struct worker *w);
+static int prio_keep(struct worker *w, struct co *current);
+static void fair_push(struct worker *w, struct co *co);
+static struct co *fair_pop(struct worker *w);
+static int fair_keep(struct worker *w, struct co *current);
+static void fair_charge(struct worker *w, struct co *prev);
+static int co_class(size_t size);
+static struct co *co_alloc(struct worker *w, int cls);
+static struct co *co_alloc_n(struct worker *w, const struct co_attr *attr,
+                             int n);
+static void co_slab(struct worker *w, int cls, size_t n);
+static struct co *co_carve(struct worker *w, int cls);
+static void co_setup(struct worker *w, struct co *co, const char *name,
+                     void (*func)(void *), void *arg,
+                     const struct co_attr *attr);
+static void co_free(struct worker *w, struct co *co);
+static struct co *shared_alloc(struct worker *w);
+static void shared_frame(struct worker *w, struct co *co);
+static void copier_loop();
+static void *co_stack_top(struct co *co);
+static void co_frame(struct co *co, void *top, void (*entry)());
+static inline void co_switch(struct worker *w, struct co *next, enum prev_op op);
+static void co_finish(struct worker *w);
+static void wrapper();
+static void scheduler(struct worker *w, enum prev_op op);
+static void co_block(int *lock);
+static void co_park(struct waitq *q, int *lock);
+static int co_wake(struct waitq *q);
+static void idle_loop();
+static void idle_park(int ms);
+static void idle_wake(int n);
+static inline void idle_notify(struct worker *w);
+static int idle_work();
+static void poller_kick();
+static void *worker_main(void *arg);
+static uint64_t now_ns();
+static void io_init();
+static struct co_fd *io_fd(int fd);
+static void io_wait(int fd, uint32_t events);
+static int co_poll(int block);
+static void co_reap(struct co *co);
+static void timer_add(struct co *co, uint64_t ns);
+static void timer_link(struct co *co);
+static void timer_unlink(struct co *co);
+static int timer_cancel(struct co *co);
+static struct co *timer_expire(uint64_t now);
+static int timer_timeout(uint64_t now);
+static void waitq_remove(struct waitq *q, struct co *co);
+static void group_done(struct co_group *g);
+static inline uint64_t co_tsc();
+static size_t co_stack_peak(struct co *co);
+static void stat_switch(struct worker *w, struct co *prev, struct co *next)
+  __attribute__((noinline, cold));
+static void stat_fold(struct co *co);
+
+static const struct policy policies[] = {
+  [CO_POLICY_RR]       = { rr_push,   rr_pop,   rr_keep },
+  [CO_POLICY_PRIORITY] = { prio_push, prio_pop, prio_keep },
+  [CO_POLICY_FAIR]     = { fair_push, fair_pop, fair_keep },
+};
+
+// save callee-saved registers on the current stack, store sp into *from,
+// load sp from *to and restore its registers (defined in asm below)
+void co_swap(void **from, void **to) __attribute__((visibility("hidden")));
 
 // extern function
 struct co *co_start(const char *name, void (*func)(void *), void *arg) {
-  debug("MESSAGE: co_start() %s\n", name);
-  for (int i = 0; i < NCO; ++i) {
-    if (co_pool[i].status == CO_FREE) {
-      strncpy(co_pool[i].name, name, NAME_SIZE);
-      co_pool[i].func = func;
-      co_pool[i].arg = arg;
-      co_pool[i].status = CO_NEW;
-      ++co_alive;
-      return &co_pool[i];
-    }
-  }
-  debug("ERROR: Coroutine number overflow %s\n", name);
-  assert(0);
+  return co_start_ex(name, func, arg, NULL);
+}
+
+struct co *co_start_ex(const char *name, void (*func)(void *), void *arg,
+                       const struct co_attr *attr) {
+  struct worker *w = this_worker();
+  struct co *co = co_alloc_n(w, attr, 1);
+  co_setup(w, co, name, func, arg, attr);
+  ready_push(w, co);
+  return co;
 }
 
 void co_wait(struct co *co) {
-  debug("MESSAGE: co_wait(%s)\n", co->name);
-  while (co->status != CO_DEAD) {
-    if (setjmp(current->context) == 0) {
-      current->status = CO_WAITING;
-      scheduler(); 
+  if (__atomic_load_n(&co->status, __ATOMIC_ACQUIRE) == CO_FREE) {
+    return; // already waited for and recycled
+  }
+  __atomic_add_fetch(&co->nwait, 1, __ATOMIC_RELAXED);
+  spin_lock(&co->lock);
+  if (co->status < CO_EXITING) {
+    // not runnable until wrapper() of co wakes us
+    co_park(&co->waiters, &co->lock);
+  } else {
+    spin_unlock(&co->lock);
+  }
+  co_reap(co);
+}
+
+int co_wait_timeout(struct co *co, uint64_t ns) {
+  if (__atomic_load_n(&co->status, __ATOMIC_ACQUIRE) == CO_FREE) {
+    return 0;
+  }
+  io_init();
+  __atomic_add_fetch(&co->nwait, 1, __ATOMIC_RELAXED);
+  spin_lock(&co->lock);
+  if (co->status < CO_EXITING) {
+    // whichever of wrapper() and the timer comes first resumes us
+    struct co *self = this_worker()->current;
+    self->waiting_on = co;
+    spin_lock(&io.lock);
+    timer_add(self, ns);
+    spin_unlock(&io.lock);
+    co_park(&co->waiters, &co->lock);
+    self->waiting_on = NULL;
+    self->timer = TIMER_NONE;
+    spin_lock(&co->lock);
+    if (co->status < CO_EXITING) {
+      // timed out: co stays valid until somebody waits for it again
+      __atomic_sub_fetch(&co->nwait, 1, __ATOMIC_RELAXED);
+      spin_unlock(&co->lock);
+      return -1;
     }
   }
-  // recycle resource
-  memset(co, 0, sizeof(co_pool[0]));
-  co->status = CO_FREE;
+  spin_unlock(&co->lock);
+  co_reap(co);
+  return 0;
 }
 
-void co_yield() {
-  debug("MESSAGE: co_yield()%s\n", "");
-  // save current env AND schedule()
-  int val = setjmp(current->context);
-  // sleep
-  if (val == 0) {
-    current->status = CO_WAITING; // change current coroutine to CO_WAITING
-    scheduler(); // select next corountine
+struct co_group *co_group_new() {
+  struct co_group *g = calloc(1, sizeof(struct co_group));
+  assert(g);
+  return g;
+}
+
+void co_group_free(struct co_group *g) {
+  spin_lock(&g->lock); // the last member may still be releasing it
+  assert(!g->pending && !g->waiters.head);
+  free(g);
+}
+
+void co_group_spawn(struct co_group *g, const char *name, int n,
+                    void (*func)(void *), void **args,
+                    const struct co_attr *attr) {
+  if (n <= 0) return;
+  struct worker *w = this_worker();
+  struct co *head = co_alloc_n(w, attr, n);
+  int i = 0;
+  for (struct co *co = head; co; co = co->next, ++i) {
+    void *arg = args ? args[i] : (void *)(intptr_t)i;
+    co_setup(w, co, name, func, arg, attr);
+    co->group = g;
   }
+  // counted before any member can run, so none finishes the group early
+  spin_lock(&g->lock);
+  g->pending += n;
+  spin_unlock(&g->lock);
+  ready_push_n(w, head);
+}
+
+void co_group_wait(struct co_group *g) {
+  spin_lock(&g->lock);
+  if (g->pending) {
+    // the last member to finish wakes us
+    co_park(&g->waiters, &g->lock);
+  } else {
+    spin_unlock(&g->lock);
+  }
+}
+
+void co_yield() {
+  struct worker *w = this_worker();
+  stat_inc(w, yields);
+  scheduler(w, PREV_READY); // select next corountine AND sleep
   // wake up
 }
 
+void co_run(int nthreads, void (*func)(void *), void *arg) {
+  assert(rt.nworkers == 0); // no nesting
+  if (nthreads <= 0) {
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (nthreads > rt.nalloc) {
+    // nothing points into rt.workers while the runtime is stopped
+    rt.workers = realloc(rt.workers, nthreads * sizeof(struct worker));
+    assert(rt.workers);
+    memset(rt.workers + rt.nalloc, 0,
+           (nthreads - rt.nalloc) * sizeof(struct worker));
+    rt.nalloc = nthreads;
+  }
+  for (int i = 0; i < nthreads; ++i) {
+    struct worker *w = &rt.workers[i];
+    // coroutines left behind by the previous run are abandoned
+    memset(&w->ready, 0, sizeof(w->ready));
+    w->policy = tls_worker->policy; // inherit the caller's policy
+    w->fair.min_vruntime = 0;
+    w->fair.slice = co_tsc();
+    w->prev_op = PREV_NONE;
+    w->seed = i + 1;
+    if (!w->idle) {
+      w->idle = co_alloc(w, co_class(STACK_SIZE));
+      strcpy(w->idle->name, "idle");
+    }
+    w->idle->status = CO_RUNNING;
+    co_frame(w->idle, co_stack_top(w->idle), idle_loop);
+    w->current = w->idle;
+  }
+  rt.done = 0;
+  rt.nworkers = nthreads;
+
+  // the calling thread becomes worker 0, its own coroutines stay frozen
+  struct worker *self = tls_worker;
+  tls_worker = &rt.workers[0];
+  rt.root = co_start("root", func, arg);
+  for (int i = 1; i < nthreads; ++i) {
+    int ret = pthread_create(&rt.workers[i].thread, NULL,
+                             worker_main, &rt.workers[i]);
+    assert(ret == 0);
+  }
+  co_swap(&rt.workers[0].boot_sp, &rt.workers[0].idle->sp);
+  for (int i = 1; i < nthreads; ++i) {
+    pthread_join(rt.workers[i].thread, NULL);
+  }
+
+  co_free(&rt.workers[0], rt.root);
+  rt.root = NULL;
+  rt.nworkers = 0;
+  tls_worker = self;
+}
+
+struct co_chan *co_chan_new(size_t cap) {
+  struct co_chan *ch = calloc(1, sizeof(struct co_chan));
+  assert(ch);
+  ch->cap = cap;
+  ch->size = cap ? cap : 16;
+  ch->buf = malloc(ch->size * sizeof(void *));
+  assert(ch->buf);
+  return ch;
+}
+
+void co_chan_free(struct co_chan *ch) {
+  assert(!ch->senders.head && !ch->receivers.head);
+  free(ch->buf);
+  free(ch);
+}
+
+int co_chan_send(struct co_chan *ch, void *val) {
+  spin_lock(&ch->lock);
+  while (ch->cap && ch->len == ch->cap && !ch->closed) {
+    co_park(&ch->senders, &ch->lock);
+    spin_lock(&ch->lock);
+  }
+  if (ch->closed) {
+    spin_unlock(&ch->lock);
+    return -1;
+  }
+  if (ch->len == ch->size) {
+    // unbounded: double the ring and unwrap it
+    void **buf = malloc(2 * ch->size * sizeof(void *));
+    assert(buf);
+    for (size_t i = 0; i < ch->len; ++i) {
+      buf[i] = ch->buf[(ch->head + i) % ch->size];
+    }
+    free(ch->buf);
+    ch->buf = buf;
+    ch->head = 0;
+    ch->size *= 2;
+  }
+  ch->buf[(ch->head + ch->len) % ch->size] = val;
+  ch->len++;
+  co_wake(&ch->receivers);
+  spin_unlock(&ch->lock);
+  return 0;
+}
+
+int co_chan_recv(struct co_chan *ch, void **val) {
+  spin_lock(&ch->lock);
+  while (ch->len == 0 && !ch->closed) {
+    co_park(&ch->receivers, &ch->lock);
+    spin_lock(&ch->lock);
+  }
+  if (ch->len == 0) {
+    spin_unlock(&ch->lock);
+    return 0; // closed and drained
+  }
+  *val = ch->buf[ch->head];
+  ch->head = (ch->head + 1) % ch->size;
+  ch->len--;
+  co_wake(&ch->senders);
+  spin_unlock(&ch->lock);
+  return 1;
+}
+
+void co_chan_close(struct co_chan *ch) {
+  spin_lock(&ch->lock);
+  ch->closed = 1;
+  while (co_wake(&ch->senders)) ;
+  while (co_wake(&ch->receivers)) ;
+  spin_unlock(&ch->lock);
+}
+
+struct co_sem *co_sem_new(int value) {
+  struct co_sem *sem = calloc(1, sizeof(struct co_sem));
+  assert(sem);
+  sem->value = value;
+  return sem;
+}
+
+void co_sem_free(struct co_sem *sem) {
+  assert(!sem->waiters.head);
+  free(sem);
+}
+
+void co_sem_wait(struct co_sem *sem) {
+  spin_lock(&sem->lock);
+  while (sem->value == 0) {
+    co_park(&sem->waiters, &sem->lock);
+    spin_lock(&sem->lock);
+  }
+  sem->value--;
+  spin_unlock(&sem->lock);
+}
+
+void co_sem_post(struct co_sem *sem) {
+  spin_lock(&sem->lock);
+  sem->value++;
+  co_wake(&sem->waiters);
+  spin_unlock(&sem->lock);
+}
+
+ssize_t co_read(int fd, void *buf, size_t count) {
+  io_fd(fd); // make fd non-blocking before the first try
+  for (;;) {
+    ssize_t ret = read(fd, buf, count);
+    if (ret >= 0 || errno != EAGAIN) return ret;
+    io_wait(fd, EPOLLIN);
+  }
+}
+
+ssize_t co_write(int fd, const void *buf, size_t count) {
+  io_fd(fd); // make fd non-blocking before the first try
+  for (;;) {
+    ssize_t ret = write(fd, buf, count);
+    if (ret >= 0 || errno != EAGAIN) return ret;
+    io_wait(fd, EPOLLOUT);
+  }
+}
+
+int co_accept(int fd, struct sockaddr *addr, socklen_t *addrlen) {
+  io_fd(fd); // make fd non-blocking before the first try
+  for (;;) {
+    int ret = accept4(fd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (ret >= 0 || errno != EAGAIN) return ret;
+    io_wait(fd, EPOLLIN);
+  }
+}
+
+int co_close(int fd) {
+  io_init();
+  assert(fd >= 0 && fd < io.nfds);
+  struct co_fd *f = &io.fds[fd];
+  spin_lock(&f->lock);
+  assert(!f->rd.head && !f->wr.head);
+  f->registered = 0;
+  f->ready = 0;
+  spin_unlock(&f->lock);
+  return close(fd);
+}
+
+void co_sleep(uint64_t ns) {
+  struct co *co = this_worker()->current;
+  io_init();
+  spin_lock(&io.lock);
+  timer_add(co, ns);
+  co_block(&io.lock);
+  co->timer = TIMER_NONE;
+}
+
+void co_set_policy(enum co_policy policy) {
+  assert(!rt.nworkers); // workers do not change policy in flight
+  struct worker *w = this_worker();
+  // requeue whatever is ready in the new order
+  struct co *head = NULL, **link = &head;
+  while (w->ready.len) {
+    *link = ready_pop(w);
+    link = &(*link)->next;
+  }
+  w->policy = policy;
+  w->fair.slice = co_tsc();
+  while (head) {
+    struct co *next = head->next;
+    ready_push(w, head);
+    head = next;
+  }
+}
+
+void co_set_priority(struct co *co, int prio) {
+// Takes effect the next time co is queued
+  if (!co) co = this_worker()->current;
+  assert(prio >= 0 && prio <= CO_PRIO_MAX);
+  co->prio = prio;
+}
+
+void co_stats_enable(int on) {
+  __atomic_store_n(&co_stats_on, on, __ATOMIC_RELAXED);
+}
+
+void co_stat(struct co *co, struct co_stat *st) {
+  if (!co) co = this_worker()->current;
+  st->switches = co->nswitch;
+  st->cycles = co->cycles;
+  st->stack_peak = co_stack_peak(co);
+}
+
+void co_stats(struct co_stats *st) {
+// Racy under co_run(), but every counter only grows
+  memset(st, 0, sizeof(*st));
+  for (int i = -1; i < rt.nalloc; ++i) {
+    struct co_stats *ws = i < 0 ? &w_main.stats : &rt.workers[i].stats;
+    st->spawns += ws->spawns;
+    st->switches += ws->switches;
+    st->yields += ws->yields;
+    st->parks += ws->parks;
+    st->steals += ws->steals;
+    st->polls += ws->polls;
+    st->timeouts += ws->timeouts;
+  }
+}
+
+void co_stats_dump(int fd) {
+  struct co_stats st;
+  co_stats(&st);
+  dprintf(fd, "spawns %llu switches %llu yields %llu parks %llu "
+              "steals %llu polls %llu timeouts %llu\n",
+          (unsigned long long)st.spawns, (unsigned long long)st.switches,
+          (unsigned long long)st.yields, (unsigned long long)st.parks,
+          (unsigned long long)st.steals, (unsigned long long)st.polls,
+          (unsigned long long)st.timeouts);
+  dprintf(fd, "%-24s %10s %12s %16s %10s\n",
+          "name", "finished", "switches", "cycles", "stack");
+  spin_lock(&co_names.lock);
+  for (int i = 0; i < STAT_NAMES; ++i) {
+    if (!co_names.tab[i].count) continue;
+    dprintf(fd, "%-24.*s %10llu %12llu %16llu %10zu\n",
+            NAME_SIZE, co_names.tab[i].name,
+            (unsigned long long)co_names.tab[i].count,
+            (unsigned long long)co_names.tab[i].switches,
+            (unsigned long long)co_names.tab[i].cycles,
+            co_names.tab[i].stack_peak);
+  }
+  spin_unlock(&co_names.lock);
+}
+
 void __attribute__((constructor)) co_init() {
   srand(time(NULL));
-  memset(co_pool, 0, NCO * sizeof(co_pool[0]));  
-  current = &co_pool[0]; // main coroutine
-  strcpy(current->name, "main");
-  current->status = CO_RUNNING;
-  co_alive = 1;
+  tls_worker = &w_main;
+  w_main.current = &co_main; // main coroutine
+  strcpy(co_main.name, "main");
+  co_main.status = CO_RUNNING;
 }
 
 
 
 /* static function */
 
-static inline void stack_switch_call(void *sp, void *entry) {
-// The address pointed by sp should be a multiple of 16
-  asm volatile (
+static struct worker *this_worker() {
+// Never inlined: after co_swap() we may be on another thread, so the
+// compiler must not reuse a thread-local address computed before it
+  return tls_worker;
+}
+
+static inline void spin_lock(int *lock) {
+  if (!rt.nworkers) return;
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+}
+
+static inline void spin_unlock(int *lock) {
+  if (!rt.nworkers) return;
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+static inline void ready_push(struct worker *w, struct co *co) {
+  spin_lock(&w->ready.lock);
+  // the default policy skips the indirect call
+  if (w->policy == CO_POLICY_RR) rr_push(w, co);
+  else policies[w->policy].push(w, co);
+  __atomic_store_n(&w->ready.len, w->ready.len + 1, __ATOMIC_RELAXED);
+  spin_unlock(&w->ready.lock);
+  if (rt.nworkers) idle_notify(w);
+}
+
+static void ready_push_n(struct worker *w, struct co *head) {
+// ready_push() every coroutine of a list linked through co->next
+  spin_lock(&w->ready.lock);
+  int n = 0;
+  for (struct co *co = head, *next; co; co = next, ++n) {
+    next = co->next;
+    if (w->policy == CO_POLICY_RR) rr_push(w, co);
+    else policies[w->policy].push(w, co);
+  }
+  __atomic_store_n(&w->ready.len, w->ready.len + n, __ATOMIC_RELAXED);
+  spin_unlock(&w->ready.lock);
+  if (rt.nworkers) idle_notify(w);
+}
+
+static inline struct co *ready_pop(struct worker *w) {
+  if (__atomic_load_n(&w->ready.len, __ATOMIC_RELAXED) == 0) return NULL;
+  spin_lock(&w->ready.lock);
+  struct co *co = ready_take(w);
+  spin_unlock(&w->ready.lock);
+  return co;
+}
+
+static inline struct co *ready_take(struct worker *w) {
+// ready_pop() with w->ready.lock held
+  if (!w->ready.len) return NULL;
+  struct co *co = w->policy == CO_POLICY_RR ? rr_pop(w)
+                                            : policies[w->policy].pop(w);
+  co->next = NULL;
+  __atomic_store_n(&w->ready.len, w->ready.len - 1, __ATOMIC_RELAXED);
+  return co;
+}
+
+static struct co *ready_steal(struct worker *w) {
+  // take the older half of some other worker's ready queue
+  int n = rt.nworkers;
+  int start = rand_r(&w->seed) % n;
+  for (int i = 0; i < n; ++i) {
+    struct worker *v = &rt.workers[(start + i) % n];
+    if (v == w || __atomic_load_n(&v->ready.len, __ATOMIC_RELAXED) == 0) {
+      continue;
+    }
+    // in the victim's order, so the most urgent ones move
+    spin_lock(&v->ready.lock);
+    struct co *head = NULL, **link = &head;
+    int k = (v->ready.len + 1) / 2;
+    for (int j = 0; j < k; ++j) {
+      *link = ready_take(v);
+      link = &(*link)->next;
+    }
+    spin_unlock(&v->ready.lock);
+    if (!k) continue;
+
+    // run the first one, queue the rest locally
+    if (co_stats_on) w->stats.steals += k;
+    struct co *co = head->next;
+    while (co) {
+      struct co *next = co->next;
+      ready_push(w, co);
+      co = next;
+    }
+    head->next = NULL;
+    return head;
+  }
+  return NULL;
+}
+
+static int ready_keep(struct worker *w) {
+  spin_lock(&w->ready.lock);
+  int keep = w->ready.len && policies[w->policy].keep(w, w->current);
+  spin_unlock(&w->ready.lock);
+  return keep;
+}
+
+static void rr_push(struct worker *w, struct co *co) {
+  co->next = NULL;
+  if (w->ready.tail) w->ready.tail->next = co;
+  else w->ready.head = co;
+  w->ready.tail = co;
+}
+
+static struct co *rr_pop(struct worker *w) {
+  struct co *prev = NULL, *co = w->ready.head;
+#ifdef SCHED_RANDOM
+  // O(len) walk, but only over ready coroutines
+  for (int cnt = rand() % w->ready.len; cnt > 0; --cnt) {
+    prev = co;
+    co = co->next;
+  }
+#endif
+  if (prev) prev->next = co->next;
+  else w->ready.head = co->next;
+  if (w->ready.tail == co) w->ready.tail = prev;
+  return co;
+}
+
+static int rr_keep(struct worker *w, struct co *current) {
+  return 0;
+}
+
+static void prio_push(struct worker *w, struct co *co) {
+// One FIFO per priority, O(1) both ways
+  struct waitq *q = &w->ready.prio[co->prio];
+  co->next = NULL;
+  if (q->tail) q->tail->next = co;
+  else q->head = co;
+  q->tail = co;
+  w->ready.prio_mask |= 1u << co->prio;
+}
+
+static struct co *prio_pop(struct worker *w) {
+  int prio = 31 - __builtin_clz(w->ready.prio_mask);
+  struct waitq *q = &w->ready.prio[prio];
+  struct co *co = q->head;
+  q->head = co->next;
+  if (!q->head) {
+    q->tail = NULL;
+    w->ready.prio_mask &= ~(1u << prio);
+  }
+  return co;
+}
+
+static int prio_keep(struct worker *w, struct co *current) {
+  // equal priorities take turns
+  return current->prio > 31 - __builtin_clz(w->ready.prio_mask);
+}
+
+static void fair_push(struct worker *w, struct co *co) {
+// A coroutine that was away gets no credit for it: it rejoins at the
+// least vruntime, so it runs soon but cannot monopolize the CPU
+  if (co->vruntime < w->fair.min_vruntime) {
+    co->vruntime = w->fair.min_vruntime;
+  }
+  if (w->ready.len == w->fair.cap) {
+    w->fair.cap = w->fair.cap ? 2 * w->fair.cap : 64;
+    w->fair.v = realloc(w->fair.v, w->fair.cap * sizeof(struct co *));
+    assert(w->fair.v);
+  }
+  struct co **v = w->fair.v;
+  int i = w->ready.len;
+  while (i > 0 && v[(i - 1) / 2]->vruntime > co->vruntime) {
+    v[i] = v[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  v[i] = co;
+}
+
+static struct co *fair_pop(struct worker *w) {
+  struct co **v = w->fair.v;
+  struct co *co = v[0], *last = v[w->ready.len - 1];
+  int n = w->ready.len - 1, i = 0;
+  for (;;) {
+    int c = 2 * i + 1;
+    if (c >= n) break;
+    if (c + 1 < n && v[c + 1]->vruntime < v[c]->vruntime) c++;
+    if (v[c]->vruntime >= last->vruntime) break;
+    v[i] = v[c];
+    i = c;
+  }
+  v[i] = last;
+  if (co->vruntime > w->fair.min_vruntime) {
+    w->fair.min_vruntime = co->vruntime;
+  }
+  return co;
+}
+
+static int fair_keep(struct worker *w, struct co *current) {
+  return current->vruntime < w->fair.v[0]->vruntime;
+}
+
+static void fair_charge(struct worker *w, struct co *prev) {
+// Charge the slice prev ran so far, scaled down by its weight 2^prio
+  uint64_t now = co_tsc();
+  prev->vruntime += (now - w->fair.slice) << (CO_PRIO_MAX - prev->prio);
+  w->fair.slice = now;
+}
+
+static int co_class(size_t size) {
+  int cls = 0;
+  while (((size_t)1 << (MIN_SHIFT + cls)) < size) ++cls;
+  assert(cls < NCLASS);
+  return cls;
+}
+
+static struct co *co_alloc(struct worker *w, int cls) {
+  struct co *co = w->pool[cls].free;
+  if (co) {
+    w->pool[cls].free = co->next;
+    return co;
+  }
+  if (w->pool[cls].next == w->pool[cls].end) co_slab(w, cls, 1);
+  return co_carve(w, cls);
+}
+
+static struct co *co_alloc_n(struct worker *w, const struct co_attr *attr,
+                             int n) {
+// n coroutines for attr linked through co->next: the recycled ones in
+// one walk, then the rest of the slab, then at most one new slab
+  struct co *head = NULL, **link = &head;
+  if (attr && attr->shared_stack) {
+    for (; n; --n, link = &(*link)->next) *link = shared_alloc(w);
+    *link = NULL;
+    return head;
+  }
+  int cls = co_class(STACK_SIZE);
+  if (attr && attr->stack_size) {
+    cls = co_class(attr->stack_size + GUARD_SIZE + sizeof(struct co) + 16);
+  }
+  struct co *co = w->pool[cls].free;
+  for (; co && n; --n, link = &co->next, co = co->next) *link = co;
+  w->pool[cls].free = co;
+  for (; n; --n, link = &(*link)->next) {
+    if (w->pool[cls].next == w->pool[cls].end) co_slab(w, cls, n);
+    *link = co_carve(w, cls);
+  }
+  *link = NULL;
+  return head;
+}
+
+static void co_slab(struct worker *w, int cls, size_t n) {
+// Map room for at least n blocks of class cls; pages are only backed
+// once touched, so RSS tracks actual stack use
+  size_t size = (size_t)1 << (MIN_SHIFT + cls);
+  size_t len = n * size < SLAB_SIZE ? SLAB_SIZE : n * size;
+  uint8_t *slab = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  assert(slab != MAP_FAILED);
+  w->pool[cls].next = slab;
+  w->pool[cls].end = slab + len;
+}
+
+static struct co *co_carve(struct worker *w, int cls) {
+  // [guard page][stack ... growing down ...][struct co]
+  size_t size = (size_t)1 << (MIN_SHIFT + cls);
+  uint8_t *stack = w->pool[cls].next;
+  w->pool[cls].next += size;
+  int ret = mprotect(stack, GUARD_SIZE, PROT_NONE);
+  assert(ret == 0);
+  struct co *co = (struct co *)(stack + size) - 1;
+  co->stack = stack;
+  co->cls = cls;
+  return co;
+}
+
+static void co_setup(struct worker *w, struct co *co, const char *name,
+                     void (*func)(void *), void *arg,
+                     const struct co_attr *attr) {
+// Make a freshly allocated co ready to be queued
+  strncpy(co->name, name, NAME_SIZE);
+  co->func = func;
+  co->arg = arg;
+  co->status = CO_NEW;
+  co->waiters.head = co->waiters.tail = NULL;
+  co->nwait = 0;
+  co->lock = 0;
+  co->group = NULL;
+  co->nswitch = co->cycles = co->tsc = 0;
+  co->prio = 0;
+  co->vruntime = 0;
+  if (attr) co_set_priority(co, attr->priority);
+  int shared = co->cls == SHARED_CLS;
+  co->filled = co_stats_on && !shared;
+  if (co->filled) {
+    uint8_t *low = co->stack + GUARD_SIZE;
+    memset(low, 0xcd, (uint8_t *)co_stack_top(co) - low);
+  }
+  stat_inc(w, spawns);
+  if (shared) {
+    shared_frame(w, co);
+  } else {
+    co_frame(co, co_stack_top(co), wrapper);
+  }
+}
+
+static void co_free(struct worker *w, struct co *co) {
+  co->status = CO_FREE;
+  if (co->cls == SHARED_CLS) {
+    free(co->save);
+    co->save = NULL;
+    co->save_cap = 0;
+    co->next = w->shared.free;
+    w->shared.free = co;
+    return;
+  }
+  co->next = w->pool[co->cls].free;
+  w->pool[co->cls].free = co;
+}
+
+static void *co_stack_top(struct co *co) {
+  return (void *)((uintptr_t)co & ~(uintptr_t)15);
+}
+
+asm (
+  ".text\n"
+  ".globl co_swap\n"
+  ".hidden co_swap\n"
+  ".type co_swap, @function\n"
+"co_swap:\n"
+#if __x86_64__
+  // from = %rdi, to = %rsi
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq (%rsi), %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+#else
+  // from = 4(%esp), to = 8(%esp)
+  "  movl 4(%esp), %eax\n"
+  "  movl 8(%esp), %edx\n"
+  "  pushl %ebp\n"
+  "  pushl %ebx\n"
+  "  pushl %esi\n"
+  "  pushl %edi\n"
+  "  movl %esp, (%eax)\n"
+  "  movl (%edx), %esp\n"
+  "  popl %edi\n"
+  "  popl %esi\n"
+  "  popl %ebx\n"
+  "  popl %ebp\n"
+  "  ret\n"
+#endif
+  ".size co_swap, .-co_swap\n"
+);
+
 #if __x86_64__
-    "movq %0, %%rsp; jmp *%1"
-      : : "b"((uintptr_t)sp - 8), "d"(entry) : "memory"
+  #define NSAVED 6 // rbp rbx r12 r13 r14 r15
 #else
-    "movl %0, %%esp; jmp *%1"
-      : : "b"((uintptr_t)sp - 16), "d"(entry) : "memory"
+  #define NSAVED 4 // ebp ebx esi edi
 #endif
-  );
+
+static void co_frame(struct co *co, void *top, void (*entry)()) {
+// The address pointed by top should be a multiple of 16
+// Lay out a frame as if co_swap() had been called from entry's caller,
+// so the first switch "returns" into entry with an ABI-aligned sp
+  uintptr_t *sp = top;
+  *--sp = 0;                // return address of entry, never used
+  *--sp = (uintptr_t)entry; // popped by co_swap's ret
+  for (int i = 0; i < NSAVED; ++i) {
+    *--sp = 0;              // callee-saved registers
+  }
+  co->sp = sp;
+}
+
+static struct co *shared_alloc(struct worker *w) {
+  assert(!rt.nworkers); // the image only fits one worker's shared stack
+  if (!w->shared.top) {
+    uint8_t *stack = mmap(NULL, SHARED_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(stack != MAP_FAILED);
+    int ret = mprotect(stack, GUARD_SIZE, PROT_NONE);
+    assert(ret == 0);
+    w->shared.top = stack + SHARED_SIZE;
+    w->shared.copier = co_alloc(w, co_class(STACK_SIZE));
+    strcpy(w->shared.copier->name, "copier");
+    co_frame(w->shared.copier, co_stack_top(w->shared.copier), copier_loop);
+  }
+  struct co *co = w->shared.free;
+  if (co) {
+    w->shared.free = co->next;
+    return co;
+  }
+  co = calloc(1, sizeof(struct co));
+  assert(co);
+  co->cls = SHARED_CLS;
+  return co;
 }
 
-static void *wrapper() {
-  debug("MESSAGE: set sp successfully%s\n", "");
-  current->func(current->arg);
+static void shared_frame(struct worker *w, struct co *co) {
+// Lay the first frame out as it would be at the top of the shared
+// stack; it holds no addresses within itself, so it can be moved there
+  uintptr_t frame[16] __attribute__((aligned(16))); // > NSAVED + 2
+  co_frame(co, frame + 16, wrapper);
+  size_t len = (uint8_t *)(frame + 16) - (uint8_t *)co->sp;
+  co->save = malloc(len);
+  assert(co->save);
+  co->save_cap = len;
+  memcpy(co->save, co->sp, len);
+  co->sp = w->shared.top - len;
+}
+
+static void copier_loop() {
+// Entered instead of a shared-stack coroutine that is not the occupant:
+// evict the occupant's live frames into a buffer sized to fit them, then
+// copy the next one's in at the same addresses and resume it
+  for (;;) {
+    struct worker *w = this_worker();
+    struct co *old = w->shared.occupant, *next = w->shared.next;
+    if (old && old->status != CO_EXITING) {
+      size_t len = w->shared.top - (uint8_t *)old->sp;
+      if (len > old->save_cap || len < old->save_cap / 4) {
+        free(old->save);
+        old->save = malloc(len);
+        assert(old->save);
+        old->save_cap = len;
+      }
+      memcpy(old->save, old->sp, len);
+    }
+    memcpy(next->sp, next->save, w->shared.top - (uint8_t *)next->sp);
+    w->shared.occupant = next;
+    co_swap(&w->shared.copier->sp, &next->sp);
+  }
+}
 
-  debug("MESSAGE: coroutine %s is done\n", current->name);
-  current->status = CO_DEAD;
-  --co_alive; assert(co_alive > 0);
-  scheduler();
-  debug("ERROR: scheduler() return%s\n", "");
+static inline void co_switch(struct worker *w, struct co *next, enum prev_op op) {
+  struct co *prev = w->current;
+  if (__builtin_expect(co_stats_on, 0)) stat_switch(w, prev, next);
+  w->prev = prev;
+  w->prev_op = op;
+  w->current = next;
+  next->status = CO_RUNNING;
+  // next's slice starts now, not when fair_charge() last ran: we may
+  // have blocked in co_poll(1) or come from idle_loop() since
+  if (w->policy == CO_POLICY_FAIR) w->fair.slice = co_tsc();
+  if (next->cls == SHARED_CLS && next != w->shared.occupant) {
+    // its frames are not on the shared stack, copier_loop() brings them
+    w->shared.next = next;
+    co_swap(&prev->sp, &w->shared.copier->sp);
+  } else {
+    co_swap(&prev->sp, &next->sp);
+  }
+  co_finish(this_worker());
+}
+
+static void co_finish(struct worker *w) {
+// Runs on the resumed side of every switch. Only now is prev's context
+// fully saved, so only now may another worker pick it up or free it.
+  struct co *prev = w->prev;
+  switch (w->prev_op) {
+    case PREV_NONE:
+      break;
+    case PREV_READY:
+      ready_push(w, prev);
+      break;
+    case PREV_PARK:
+      // the lock was held across the switch, so no wakeup is lost and
+      // nobody could resume prev before its context was saved
+      spin_unlock(w->park_lock);
+      break;
+    case PREV_DEAD:
+      if (prev == rt.root) {
+        __atomic_store_n(&rt.done, 1, __ATOMIC_RELEASE);
+        idle_wake(rt.nworkers);
+        poller_kick();
+      }
+      if (co_stats_on) stat_fold(prev);
+      if (prev == w->shared.occupant) {
+        w->shared.occupant = NULL; // nothing to save any more
+      }
+      if (prev->group) {
+        co_free(w, prev); // nobody waits for it on its own
+        break;
+      }
+      __atomic_store_n(&prev->status, CO_DEAD, __ATOMIC_RELEASE);
+      break;
+  }
+  w->prev_op = PREV_NONE;
+}
+
+static void wrapper() {
+  struct worker *w = this_worker();
+  co_finish(w);
+  struct co *co = w->current;
+  co->func(co->arg);
+
+  if (co->group) group_done(co->group);
+  spin_lock(&co->lock);
+  co->status = CO_EXITING;
+  // wake every waiter exactly once; they may run before we have
+  // switched out, but will not free us till then
+  while (co_wake(&co->waiters)) ;
+  spin_unlock(&co->lock);
+  scheduler(this_worker(), PREV_DEAD);
   assert(0);
-  return NULL;
 }
 
-static void scheduler() {
+static void scheduler(struct worker *w, enum prev_op op) {
   // select a valid coroutine AND switch current to it
-  debug("MESSAGE: scheduler()%s ", "");
-  assert(current->status != CO_RUNNING);
-  int cnt, select;
-  cnt = rand() % co_alive + 1;
-  for (select = 0; select < NCO; ++select)
-    if (co_pool[select].status == CO_NEW || co_pool[select].status == CO_WAITING) 
-      if (--cnt == 0) break;
-  debug("co_pool[%d]", select);
-  assert(select < NCO);
-
-  current = &co_pool[select];
-  if (current->status == CO_NEW) {
-    // change sp and func(arg)
-    debug(".status: NEW%s\n", "");
-    current->status = CO_RUNNING;
-    // initial the func's sp & switch context
-    stack_switch_call(&current->stack[STACK_SIZE], wrapper);
-  }
-  if (current->status == CO_WAITING) {
-    debug(".status: WAITING%s\n", "");
-    current->status = CO_RUNNING;
-    longjmp(current->context, 1);
-  }
-  debug("ERROR: Wrong status: %d\n", current->status);
-  assert(0);
-}
\ No newline at end of file
+  struct co *next;
+  if (rt.nworkers && __atomic_load_n(&rt.done, __ATOMIC_ACQUIRE)) {
+    next = w->idle; // shutting down
+  } else {
+    // co_poll() takes fd and timer locks, so it must not run while we
+    // hold a park lock; locks are no-ops in the single-threaded runtime
+    int can_poll = op != PREV_PARK || !rt.nworkers;
+    if (can_poll && (++w->nsched % POLL_INTERVAL == 0 || !w->ready.len)) {
+      co_poll(0); // do not starve I/O behind busy coroutines
+    }
+    if (w->policy != CO_POLICY_RR) {
+      if (w->policy == CO_POLICY_FAIR) fair_charge(w, w->current);
+      if (op == PREV_READY && ready_keep(w)) return;
+    }
+    next = ready_pop(w);
+    // single-threaded and nothing runnable: block on I/O and timers
+    while (!next && op != PREV_READY && !rt.nworkers && co_poll(1)) {
+      next = ready_pop(w);
+    }
+  }
+  if (!next) {
+    if (op == PREV_READY) return; // nothing else to run, keep going
+    assert(rt.nworkers);          // single-threaded: a deadlock
+    next = w->idle;
+  }
+  if (op != PREV_DEAD) {
+    w->current->status = CO_WAITING;
+  }
+  co_switch(w, next, op);
+}
+
+static void co_block(int *lock) {
+// The caller holds lock and has linked us where a waker will find us;
+// co_finish() drops lock once our context is saved
+  struct worker *w = this_worker();
+  stat_inc(w, parks);
+  w->park_lock = lock;
+  scheduler(w, PREV_PARK);
+}
+
+static void co_park(struct waitq *q, int *lock) {
+// The caller holds lock and has checked it must block
+  struct co *co = this_worker()->current;
+  co->next = NULL;
+  if (q->tail) q->tail->next = co;
+  else q->head = co;
+  q->tail = co;
+  co_block(lock);
+}
+
+static int co_wake(struct waitq *q) {
+// Make the first coroutine parked on q runnable; the caller holds the lock
+  struct co *co = q->head;
+  if (!co) return 0;
+  q->head = co->next;
+  if (!q->head) q->tail = NULL;
+  if (co->timer != TIMER_NONE && !timer_cancel(co)) {
+    return 1; // its timer fired first, co_poll() resumes it
+  }
+  ready_push(this_worker(), co);
+  return 1;
+}
+
+static void waitq_remove(struct waitq *q, struct co *co) {
+// Unlink co if it is still parked on q; the caller holds the lock
+  struct co *prev = NULL;
+  for (struct co *it = q->head; it; prev = it, it = it->next) {
+    if (it == co) {
+      if (prev) prev->next = co->next;
+      else q->head = co->next;
+      if (q->tail == co) q->tail = prev;
+      return;
+    }
+  }
+}
+
+static void group_done(struct co_group *g) {
+// A member is about to finish; the last one wakes the joiners, which
+// may return before it has switched out, co_finish() recycles it then
+  spin_lock(&g->lock);
+  if (--g->pending == 0) {
+    while (co_wake(&g->waiters)) ;
+  }
+  spin_unlock(&g->lock);
+}
+
+static void co_reap(struct co *co) {
+// co has finished and we were counted in co->nwait
+  if (__atomic_load_n(&co->status, __ATOMIC_ACQUIRE) != CO_DEAD) {
+    // co may still be leaving its stack on another worker
+    while (__atomic_load_n(&co->status, __ATOMIC_ACQUIRE) != CO_DEAD) {
+      sched_yield();
+    }
+  }
+  // recycle resource, keeping the stack mapped for the next co_start()
+  if (__atomic_sub_fetch(&co->nwait, 1, __ATOMIC_ACQ_REL) == 0) {
+    co_free(this_worker(), co);
+  }
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void io_init() {
+  if (__atomic_load_n(&io.fds, __ATOMIC_ACQUIRE)) return;
+  spin_lock(&io.lock);
+  if (!io.fds) {
+    io.epfd = epoll_create1(EPOLL_CLOEXEC);
+    io.evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(io.epfd >= 0 && io.evfd >= 0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = io.evfd };
+    int ret = epoll_ctl(io.epfd, EPOLL_CTL_ADD, io.evfd, &ev);
+    assert(ret == 0);
+    // fds are below the hard RLIMIT_NOFILE, which the soft one can be
+    // raised to at any time; untouched entries cost no memory, so only
+    // a quarter of the address space bounds it
+    struct rlimit rl;
+    ret = getrlimit(RLIMIT_NOFILE, &rl);
+    assert(ret == 0);
+    rlim_t max = (SIZE_MAX >> 2) / sizeof(struct co_fd);
+    if (max > INT_MAX) max = INT_MAX;
+    io.nfds = rl.rlim_max < max ? rl.rlim_max : max;
+    struct co_fd *fds = mmap(NULL, io.nfds * sizeof(struct co_fd),
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(fds != MAP_FAILED);
+    __atomic_store_n(&io.fds, fds, __ATOMIC_RELEASE);
+  }
+  spin_unlock(&io.lock);
+}
+
+static struct co_fd *io_fd(int fd) {
+  io_init();
+  assert(fd >= 0 && fd < io.nfds);
+  struct co_fd *f = &io.fds[fd];
+  spin_lock(&f->lock);
+  if (!f->registered) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) {
+      fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+    // edge-triggered: we always try the syscall before parking
+    struct epoll_event ev = {
+      .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+      .data.fd = fd,
+    };
+    if (epoll_ctl(io.epfd, EPOLL_CTL_ADD, fd, &ev) == 0 || errno == EEXIST) {
+      f->registered = 1;
+    }
+  }
+  spin_unlock(&f->lock);
+  return f;
+}
+
+static void io_wait(int fd, uint32_t events) {
+// Park until fd reports events; returns early on an edge nobody took
+  struct co_fd *f = io_fd(fd);
+  spin_lock(&f->lock);
+  if (!f->registered || (f->ready & events)) {
+    // regular files cannot be polled, and may simply be retried
+    f->ready &= ~events;
+    spin_unlock(&f->lock);
+    return;
+  }
+  __atomic_add_fetch(&io.nwait, 1, __ATOMIC_RELAXED);
+  co_park(events == EPOLLIN ? &f->rd : &f->wr, &f->lock);
+  __atomic_sub_fetch(&io.nwait, 1, __ATOMIC_RELAXED);
+}
+
+static int co_poll(int block) {
+// Make coroutines whose fd is ready or whose timer fired runnable.
+// With block, wait for the first of them. Returns 0 if nobody waits.
+  if (!__atomic_load_n(&io.fds, __ATOMIC_ACQUIRE)) return 0;
+  struct worker *w = this_worker();
+  int timeout = 0;
+  uint64_t now = now_ns();
+  spin_lock(&io.lock);
+  struct co *fired = timer_expire(now);
+  int pending = io.ntimer || __atomic_load_n(&io.nwait, __ATOMIC_RELAXED);
+  if (block && !fired && pending) {
+    timeout = timer_timeout(now);
+  }
+  spin_unlock(&io.lock);
+  int woken = 0;
+  while (fired) {
+    struct co *co = fired;
+    fired = co->tnext;
+    if (co->waiting_on) {
+      // wrapper() may have dequeued it already, see co_wake()
+      spin_lock(&co->waiting_on->lock);
+      waitq_remove(&co->waiting_on->waiters, co);
+      spin_unlock(&co->waiting_on->lock);
+    }
+    ready_push(w, co);
+    stat_inc(w, timeouts);
+    woken++;
+  }
+  if (!pending) return woken;
+
+  struct epoll_event evs[NEVENT];
+  stat_inc(w, polls);
+  int n = epoll_wait(io.epfd, evs, NEVENT, timeout);
+  for (int i = 0; i < n; ++i) {
+    if (evs[i].data.fd == io.evfd) {
+      uint64_t count;
+      read(io.evfd, &count, sizeof(count)); // poller_kick(), just wake
+      continue;
+    }
+    struct co_fd *f = &io.fds[evs[i].data.fd];
+    uint32_t ev = evs[i].events;
+    if (ev & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) ev |= EPOLLIN | EPOLLOUT;
+    spin_lock(&f->lock);
+    if (ev & EPOLLIN) {
+      if (!f->rd.head) f->ready |= EPOLLIN;
+      while (co_wake(&f->rd)) ;
+    }
+    if (ev & EPOLLOUT) {
+      if (!f->wr.head) f->ready |= EPOLLOUT;
+      while (co_wake(&f->wr)) ;
+    }
+    spin_unlock(&f->lock);
+  }
+  if (timeout != 0) {
+    co_poll(0); // collect the timers we waited for
+  }
+  return 1;
+}
+
+static void timer_add(struct co *co, uint64_t ns) {
+// Arm the timer of co, due ns from now; the caller holds io.lock
+  uint64_t now = now_ns();
+  if (!io.ntimer) {
+    io.tick = now >> TICK_SHIFT; // nothing to catch up with
+  }
+  // round up, so that we never fire early
+  co->expires = (now + ns + (1 << TICK_SHIFT) - 1) >> TICK_SHIFT;
+  co->timer = TIMER_ARMED;
+  io.ntimer++;
+  timer_link(co);
+  poller_kick(); // it may be due before the poller would look again
+}
+
+static void timer_link(struct co *co) {
+// O(1): the level follows from how far away the expiry is
+  uint64_t delta = co->expires > io.tick ? co->expires - io.tick : 0;
+  uint64_t expires = io.tick + delta;
+  int level = 0;
+  while (level < WHEEL_LEVELS - 1 &&
+         delta >= 1ull << (WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  if (delta >> (WHEEL_BITS * WHEEL_LEVELS)) {
+    expires = io.tick + (1ull << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+  }
+  struct co **slot =
+    &io.wheel[level][(expires >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)];
+  co->tnext = *slot;
+  if (*slot) (*slot)->tpprev = &co->tnext;
+  *slot = co;
+  co->tpprev = slot;
+}
+
+static void timer_unlink(struct co *co) {
+  *co->tpprev = co->tnext;
+  if (co->tnext) co->tnext->tpprev = co->tpprev;
+  co->tpprev = NULL;
+}
+
+static int timer_cancel(struct co *co) {
+// Returns 0 if the timer has fired already
+  spin_lock(&io.lock);
+  int armed = co->timer == TIMER_ARMED;
+  if (armed) {
+    timer_unlink(co);
+    io.ntimer--;
+    co->timer = TIMER_NONE;
+  }
+  spin_unlock(&io.lock);
+  return armed;
+}
+
+static struct co *timer_expire(uint64_t now) {
+// Advance the wheel to now and return the fired timers, linked through
+// tnext; the caller holds io.lock
+  struct co *fired = NULL;
+  now >>= TICK_SHIFT;
+  while (io.ntimer && io.tick <= now) {
+    // entering a new round of level k: spread its slot over level k - 1
+    for (int level = 1; level < WHEEL_LEVELS; ++level) {
+      if (io.tick & ((1ull << (WHEEL_BITS * level)) - 1)) break;
+      struct co **slot =
+        &io.wheel[level][(io.tick >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)];
+      struct co *co = *slot;
+      *slot = NULL;
+      while (co) {
+        struct co *next = co->tnext;
+        timer_link(co);
+        co = next;
+      }
+    }
+    struct co **slot = &io.wheel[0][io.tick & (WHEEL_SIZE - 1)];
+    while (*slot) {
+      struct co *co = *slot;
+      timer_unlink(co);
+      io.ntimer--;
+      co->timer = TIMER_FIRED;
+      co->tnext = fired;
+      fired = co;
+    }
+    io.tick++;
+  }
+  return fired;
+}
+
+static int timer_timeout(uint64_t now) {
+// Milliseconds until the next level 0 timer, or until the wheel needs
+// to cascade; the caller holds io.lock
+  if (!io.ntimer) return -1;
+  uint64_t tick = io.tick;
+  // the first tick of a round may cascade, so never wait past it
+  if (tick & (WHEEL_SIZE - 1)) {
+    while (!io.wheel[0][tick & (WHEEL_SIZE - 1)] &&
+           (++tick & (WHEEL_SIZE - 1))) ;
+  }
+  uint64_t at = tick << TICK_SHIFT;
+  // round up, so that we do not wake just before the deadline
+  return at > now ? (at - now + 999999) / 1000000 : 0;
+}
+
+static inline uint64_t co_tsc() {
+  return __builtin_ia32_rdtsc();
+}
+
+static size_t co_stack_peak(struct co *co) {
+// The lowest byte that no longer holds STACK_FILL marks the peak
+  if (!co->filled) return 0;
+  uint64_t *p = (uint64_t *)(co->stack + GUARD_SIZE);
+  uint64_t *top = co_stack_top(co);
+  while (p < top && *p == STACK_FILL) p++;
+  return (uint8_t *)top - (uint8_t *)p;
+}
+
+static void stat_switch(struct worker *w, struct co *prev, struct co *next) {
+// Kept out of line, so that co_switch() stays small enough to inline
+  uint64_t now = co_tsc();
+  if (prev->tsc) prev->cycles += now - prev->tsc;
+  next->tsc = now;
+  next->nswitch++;
+  w->stats.switches++;
+}
+
+static void stat_fold(struct co *co) {
+// Add a finished coroutine to the totals of its name
+  unsigned h = 2166136261u; // FNV-1a
+  for (int i = 0; i < NAME_SIZE && co->name[i]; ++i) {
+    h = (h ^ (uint8_t)co->name[i]) * 16777619u;
+  }
+  spin_lock(&co_names.lock);
+  for (int i = 0; i < STAT_NAMES; ++i) {
+    int k = (h + i) % STAT_NAMES;
+    if (!co_names.tab[k].count) {
+      memcpy(co_names.tab[k].name, co->name, NAME_SIZE);
+    } else if (strncmp(co_names.tab[k].name, co->name, NAME_SIZE)) {
+      continue;
+    }
+    co_names.tab[k].count++;
+    co_names.tab[k].switches += co->nswitch;
+    co_names.tab[k].cycles += co->cycles;
+    size_t peak = co_stack_peak(co);
+    if (peak > co_names.tab[k].stack_peak) co_names.tab[k].stack_peak = peak;
+    break; // a full table drops the rest
+  }
+  spin_unlock(&co_names.lock);
+}
+
+static void idle_loop() {
+// The idle coroutine of a worker: find work, or leave at shutdown
+  struct worker *w = this_worker();
+  co_finish(w);
+  for (;;) {
+    if (__atomic_load_n(&rt.done, __ATOMIC_ACQUIRE)) {
+      co_swap(&w->idle->sp, &w->boot_sp); // never resumed
+    }
+    struct co *next = ready_pop(w);
+    if (!next) next = ready_steal(w);
+    if (next) {
+      co_switch(w, next, PREV_NONE);
+      w = this_worker();
+    } else if (co_poll(0) &&
+               !__atomic_exchange_n(&rt.poller, w, __ATOMIC_SEQ_CST)) {
+      // fds or timers are pending: we wait for them, the others sleep;
+      // the same handshake as idle_park(), with poller_kick() to wake us
+      if (!idle_work()) co_poll(1);
+      // hand the wait over to a sleeper while we run what we found
+      __atomic_store_n(&rt.poller, NULL, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&rt.nidle, __ATOMIC_SEQ_CST)) idle_wake(1);
+    } else {
+      idle_park(-1);
+    }
+  }
+}
+
+static void idle_park(int ms) {
+// Sleep until idle_wake(), or for ms unless it is -1. We count ourselves
+// idle before the last look at the ready queues, and ready_push() looks
+// at the count after queueing, so one of us sees the other.
+  int seq = __atomic_load_n(&rt.wake_seq, __ATOMIC_ACQUIRE);
+  __atomic_add_fetch(&rt.nidle, 1, __ATOMIC_SEQ_CST);
+  if (!idle_work()) {
+    struct timespec ts = { ms / 1000, ms % 1000 * 1000000L };
+    syscall(SYS_futex, &rt.wake_seq, FUTEX_WAIT_PRIVATE, seq,
+            ms < 0 ? NULL : &ts, NULL, 0);
+  }
+  __atomic_sub_fetch(&rt.nidle, 1, __ATOMIC_RELAXED);
+}
+
+static int idle_work() {
+// Whether there is anything to run or steal, fds or timers nobody waits
+// for, or we should stop
+  if (__atomic_load_n(&rt.done, __ATOMIC_ACQUIRE)) return 1;
+  for (int i = 0; i < rt.nworkers; ++i) {
+    if (__atomic_load_n(&rt.workers[i].ready.len, __ATOMIC_SEQ_CST)) return 1;
+  }
+  return !__atomic_load_n(&rt.poller, __ATOMIC_SEQ_CST) &&
+         (__atomic_load_n(&io.ntimer, __ATOMIC_RELAXED) ||
+          __atomic_load_n(&io.nwait, __ATOMIC_RELAXED));
+}
+
+static void idle_wake(int n) {
+// Wake up to n workers in idle_park()
+  __atomic_add_fetch(&rt.wake_seq, 1, __ATOMIC_RELEASE);
+  syscall(SYS_futex, &rt.wake_seq, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static void poller_kick() {
+// End the wait of the worker in co_poll(1), if there is one
+  if (!rt.nworkers || !__atomic_load_n(&rt.poller, __ATOMIC_SEQ_CST)) return;
+  uint64_t one = 1;
+  write(io.evfd, &one, sizeof(one));
+}
+
+static inline void idle_notify(struct worker *w) {
+// After w queued work: a sleeping worker may run or steal it, or else
+// the poller may, unless w is the poller itself
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&rt.nidle, __ATOMIC_RELAXED)) {
+    idle_wake(1);
+  } else {
+    struct worker *p = __atomic_load_n(&rt.poller, __ATOMIC_RELAXED);
+    if (p && p != w) poller_kick();
+  }
+}
+
+static void *worker_main(void *arg) {
+  struct worker *w = arg;
+  tls_worker = w;
+  co_swap(&w->boot_sp, &w->idle->sp);
+  return NULL;
+}
@@ -1,3 +1,101 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#define CO_PRIO_MAX 7
+
+struct co_attr {
+  size_t stack_size; // usable stack in bytes, 0 for the default
+  int    priority;   // 0 .. CO_PRIO_MAX, see co_set_priority()
+  // run on one stack shared with the other such coroutines, copying the
+  // live frames out and in on a switch: memory follows actual stack use,
+  // but pointers into its stack must not be used by others, and it is
+  // for the single-threaded runtime only
+  int    shared_stack;
+};
+
 struct co* co_start(const char *name, void (*func)(void *), void *arg);
+struct co* co_start_ex(const char *name, void (*func)(void *), void *arg,
+                       const struct co_attr *attr);
 void co_yield();
 void co_wait(struct co *co);
+
+// fork-join: spawn n members at once, member i running func(args[i]),
+// or func((void *)i) when args is NULL; they cannot be co_wait()ed for
+// one by one, co_group_wait() returns once all spawned so far finished
+struct co_group *co_group_new();
+void co_group_free(struct co_group *g); // no members left
+void co_group_spawn(struct co_group *g, const char *name, int n,
+                    void (*func)(void *), void **args,
+                    const struct co_attr *attr);
+void co_group_wait(struct co_group *g);
+
+// run func(arg) as a coroutine on nthreads worker threads (<= 0: one per
+// core) and return once it returns; coroutines it started but did not
+// wait for are abandoned
+void co_run(int nthreads, void (*func)(void *), void *arg);
+
+// how a runtime picks the next ready coroutine
+enum co_policy {
+  CO_POLICY_RR = 0,   // round-robin, the default
+  CO_POLICY_PRIORITY, // strict: always the highest priority one
+  CO_POLICY_FAIR,     // CPU time in proportion to 2^priority
+};
+
+// set the policy of the single-threaded runtime, which co_run() passes
+// on to its workers; call it outside co_run()
+void co_set_policy(enum co_policy policy);
+// 0 (the default) .. CO_PRIO_MAX, used from the next time co is queued;
+// NULL: the current coroutine
+void co_set_priority(struct co *co, int prio);
+
+// channel of pointers: cap > 0 is bounded, cap == 0 grows without bound;
+// send returns -1 once closed, recv returns 0 once closed and drained
+struct co_chan *co_chan_new(size_t cap);
+void co_chan_free(struct co_chan *ch);
+int  co_chan_send(struct co_chan *ch, void *val);
+int  co_chan_recv(struct co_chan *ch, void **val);
+void co_chan_close(struct co_chan *ch);
+
+// counting semaphore
+struct co_sem *co_sem_new(int value);
+void co_sem_free(struct co_sem *sem);
+void co_sem_wait(struct co_sem *sem);
+void co_sem_post(struct co_sem *sem);
+
+// blocking I/O that parks the coroutine instead of the thread; fds are
+// switched to O_NONBLOCK on first use and must be closed with co_close()
+ssize_t co_read(int fd, void *buf, size_t count);
+ssize_t co_write(int fd, const void *buf, size_t count);
+int co_accept(int fd, struct sockaddr *addr, socklen_t *addrlen);
+int co_close(int fd);
+void co_sleep(uint64_t ns);
+
+// co_wait() that gives up after ns: returns 0 once co has finished, or
+// -1 on timeout, and then co must still be waited for
+int co_wait_timeout(struct co *co, uint64_t ns);
+
+// opt-in statistics, off by default; coroutines started while enabled
+// also get their stack watermarked to find its peak use
+struct co_stat {
+  uint64_t switches;   // times it was resumed
+  uint64_t cycles;     // TSC cycles it ran for
+  size_t   stack_peak; // bytes, 0 unless watermarked
+};
+
+struct co_stats {
+  uint64_t spawns;   // co_start() calls
+  uint64_t switches; // context switches, to idle coroutines too
+  uint64_t yields;   // co_yield() calls
+  uint64_t parks;    // blocked on a coroutine, channel, fd, timer, ...
+  uint64_t steals;   // coroutines taken from another worker
+  uint64_t polls;    // epoll_wait() calls
+  uint64_t timeouts; // timers fired
+};
+
+void co_stats_enable(int on);
+void co_stat(struct co *co, struct co_stat *st); // NULL: the current one
+void co_stats(struct co_stats *st);
+// global counters, then totals of the finished coroutines by name
+void co_stats_dump(int fd);
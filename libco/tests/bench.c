@@ -0,0 +1,600 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "co-test.h"
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static long rss_kb() {
+    long pages = 0, rss = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp) {
+        fscanf(fp, "%ld %ld", &pages, &rss);
+        fclose(fp);
+    }
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// sorts the n samples in place
+static uint64_t percentile(uint64_t *v, int n, int p) {
+    qsort(v, n, sizeof(uint64_t), cmp_u64);
+    return v[(long)n * p / 100 < n ? (long)n * p / 100 : n - 1];
+}
+
+// one JSON object per line, so that runs can be diffed and plotted:
+// {"bench":"switch","bits":64,...}
+static void report(const char *bench, const char *fmt, ...) {
+    va_list ap;
+    printf("{\"bench\":\"%s\",\"bits\":%d,", bench, (int)(8 * sizeof(void *)));
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("}\n");
+    fflush(stdout);
+}
+
+static const char *stack_name(size_t stack_size, int shared) {
+    static char buf[32];
+    if (shared) return "shared";
+    snprintf(buf, sizeof(buf), "%zu", stack_size);
+    return buf;
+}
+
+// -----------------------------------------------
+
+#define SWITCHES (1 << 22)
+
+#define NSAMPLE 4096
+
+static int rounds;
+static uint64_t samples[NSAMPLE];
+static int nsample;
+
+static void yield_loop(void *arg) {
+    for (int i = 0; i < rounds; ++i) {
+        co_yield();
+    }
+}
+
+static void yield_timed(void *arg) {
+    // how long a yield takes to come back: one turn of the ready queue
+    for (int i = 0; i < rounds; ++i) {
+        uint64_t start = now_ns();
+        co_yield();
+        if (nsample < NSAMPLE) samples[nsample++] = now_ns() - start;
+    }
+}
+
+static double run_yielders(int n, struct co_attr *attr, void (*first)(void *)) {
+    struct co **thd = malloc(n * sizeof(struct co *));
+    uint64_t start = now_ns();
+    for (int i = 0; i < n; ++i) {
+        thd[i] = co_start_ex("yield", i ? yield_loop : first, NULL, attr);
+    }
+    for (int i = 0; i < n; ++i) {
+        co_wait(thd[i]);
+    }
+    free(thd);
+    return now_ns() - start;
+}
+
+// n coroutines yield SWITCHES/n times each while main waits for them;
+// n == 2 is a ping-pong, more is an n-way round robin
+static void bench_switch(int n, size_t stack_size, int shared) {
+    struct co_attr attr = { .stack_size = stack_size, .shared_stack = shared };
+    rounds = SWITCHES / n;
+    double ns = run_yielders(n, &attr, yield_loop);
+    double switches = (double)n * rounds;
+    // a second, shorter run samples the resume latency
+    rounds = NSAMPLE < SWITCHES / 4 / n ? NSAMPLE : SWITCHES / 4 / n + 1;
+    nsample = 0;
+    run_yielders(n, &attr, yield_timed);
+    report(n == 2 ? "pingpong" : "roundrobin",
+        "\"coroutines\":%d,\"stack\":\"%s\",\"ns_per_switch\":%.1f,"
+        "\"switches_per_s\":%.0f,\"p50_resume_ns\":%llu,\"p99_resume_ns\":%llu",
+        n, stack_name(stack_size, shared), ns / switches, switches / ns * 1e9,
+        (unsigned long long)percentile(samples, nsample, 50),
+        (unsigned long long)percentile(samples, nsample, 99));
+}
+
+// -----------------------------------------------
+
+static void idle(void *arg) {
+    co_yield();
+}
+
+// n coroutines alive at the same time, each touching a little stack
+static void bench_spawn(int n, size_t stack_size, int shared) {
+    struct co_attr attr = { .stack_size = stack_size, .shared_stack = shared };
+    struct co **thd = malloc(n * sizeof(struct co *));
+    long rss = rss_kb();
+    uint64_t start = now_ns();
+    for (int i = 0; i < n; ++i) {
+        thd[i] = co_start_ex("idle", idle, NULL, &attr);
+    }
+    co_yield(); // every coroutine is now parked in co_yield()
+    uint64_t ns = now_ns() - start;
+    long used = rss_kb() - rss;
+    for (int i = 0; i < n; ++i) {
+        co_wait(thd[i]);
+    }
+    report("spawn",
+        "\"coroutines\":%d,\"stack\":\"%s\",\"spawns_per_s\":%.0f,"
+        "\"kib_per_co\":%.2f",
+        n, stack_name(stack_size, shared), (double)n / ns * 1e9, (double)used / n);
+    free(thd);
+}
+
+// -----------------------------------------------
+
+#define CHURN (1 << 18)
+
+static void nop(void *arg) {
+}
+
+// short-lived coroutines: start batch of them, join them, again
+static void bench_churn(int batch, int shared) {
+    struct co_attr attr = { .shared_stack = shared };
+    struct co **thd = malloc(batch * sizeof(struct co *));
+    uint64_t start = now_ns();
+    for (int t = 0; t < CHURN / batch; ++t) {
+        for (int i = 0; i < batch; ++i) {
+            thd[i] = co_start_ex("nop", nop, NULL, &attr);
+        }
+        for (int i = 0; i < batch; ++i) {
+            co_wait(thd[i]);
+        }
+    }
+    uint64_t ns = now_ns() - start;
+    int n = CHURN / batch * batch;
+    report("churn",
+        "\"batch\":%d,\"stack\":\"%s\",\"spawns_per_s\":%.0f,"
+        "\"ns_per_spawn_join\":%.1f",
+        batch, stack_name(0, shared), n / (ns / 1e9), (double)ns / n);
+    free(thd);
+}
+
+// bench_churn() through one co_group per round
+static void bench_group(int batch) {
+    struct co_group *g = co_group_new();
+    uint64_t start = now_ns();
+    for (int t = 0; t < CHURN / batch; ++t) {
+        co_group_spawn(g, "nop", batch, nop, NULL, NULL);
+        co_group_wait(g);
+    }
+    uint64_t ns = now_ns() - start;
+    int n = CHURN / batch * batch;
+    report("group",
+        "\"batch\":%d,\"spawns_per_s\":%.0f,\"ns_per_spawn_join\":%.1f",
+        batch, n / (ns / 1e9), (double)ns / n);
+    co_group_free(g);
+}
+
+// -----------------------------------------------
+
+static void chain_link(void *arg) {
+    co_wait((struct co *)arg);
+}
+
+// test_3 of main.c: coroutine i waits for coroutine i-1
+static void bench_chain(int depth) {
+    struct co **thd = malloc(depth * sizeof(struct co *));
+    int rounds = 100;
+    uint64_t start = now_ns();
+    for (int t = 0; t < rounds; ++t) {
+        thd[0] = co_start("chain", idle, NULL);
+        for (int i = 1; i < depth; ++i) {
+            thd[i] = co_start("chain", chain_link, thd[i - 1]);
+        }
+        for (int i = depth - 1; i >= 0; --i) {
+            co_wait(thd[i]);
+        }
+    }
+    uint64_t ns = now_ns() - start;
+    report("chain", "\"depth\":%d,\"ns_per_co\":%.1f",
+        depth, (double)ns / rounds / depth);
+    free(thd);
+}
+
+// -----------------------------------------------
+
+#define NITEMS (1 << 20)
+
+static int running;
+
+static void q_producer(void *arg) {
+    Queue *queue = (Queue *)arg;
+    Item *items = malloc(NITEMS / 2 * sizeof(Item));
+    for (int i = 0; i < NITEMS / 2; ) {
+        if (!q_is_full(queue)) {
+            q_push(queue, &items[i]);
+            i += 1;
+        }
+        co_yield();
+    }
+    while (!q_is_empty(queue)) {
+        co_yield(); // items must outlive the queue entries
+    }
+    free(items);
+}
+
+static void q_consumer(void *arg) {
+    Queue *queue = (Queue *)arg;
+    while (running) {
+        if (!q_is_empty(queue)) {
+            q_pop(queue);
+        }
+        co_yield();
+    }
+}
+
+static void c_producer(void *arg) {
+    for (uintptr_t i = 0; i < NITEMS / 2; ++i) {
+        co_chan_send(arg, (void *)i);
+    }
+}
+
+static void c_consumer(void *arg) {
+    void *val;
+    while (co_chan_recv(arg, &val)) ;
+}
+
+// test_2 of main.c: 2 producers and 2 consumers, spinning on a Queue
+// with co_yield() versus blocking on a channel of the same capacity
+static void bench_pipe(int chan) {
+    Queue *queue = q_new();
+    struct co_chan *ch = co_chan_new(queue->cap);
+    struct co *thd[4];
+    running = 1;
+    uint64_t start = now_ns();
+    for (int i = 0; i < 2; ++i) {
+        thd[i] = chan ? co_start("producer", c_producer, ch)
+                      : co_start("producer", q_producer, queue);
+        thd[i + 2] = chan ? co_start("consumer", c_consumer, ch)
+                          : co_start("consumer", q_consumer, queue);
+    }
+    co_wait(thd[0]);
+    co_wait(thd[1]);
+    running = 0;
+    co_chan_close(ch);
+    co_wait(thd[2]);
+    co_wait(thd[3]);
+    uint64_t ns = now_ns() - start;
+    report("pipe", "\"kind\":\"%s\",\"items_per_s\":%.0f",
+        chan ? "co_chan" : "Queue", NITEMS / (ns / 1e9));
+    co_chan_free(ch);
+    free(queue);
+}
+
+#define NSTAGE_MAX 16
+
+static struct co_chan *stage_chan[NSTAGE_MAX + 1];
+
+static void stage_source(void *arg) {
+    // timestamps are truncated to a pointer, differences still hold
+    for (int i = 0; i < NITEMS / 4; ++i) {
+        co_chan_send(stage_chan[0], (void *)(uintptr_t)now_ns());
+    }
+    co_chan_close(stage_chan[0]);
+}
+
+static void stage(void *arg) {
+    intptr_t k = (intptr_t)arg;
+    void *val;
+    while (co_chan_recv(stage_chan[k], &val)) {
+        co_chan_send(stage_chan[k + 1], val);
+    }
+    co_chan_close(stage_chan[k + 1]);
+}
+
+// a source, nstage forwarding stages and main as the sink, linked by
+// bounded channels; items carry their send time for the latency
+static void bench_pipeline(int nstage, size_t cap) {
+    struct co *thd[NSTAGE_MAX + 1];
+    for (int k = 0; k <= nstage; ++k) {
+        stage_chan[k] = co_chan_new(cap);
+    }
+    nsample = 0;
+    uint64_t start = now_ns();
+    thd[0] = co_start("source", stage_source, NULL);
+    for (int k = 0; k < nstage; ++k) {
+        thd[k + 1] = co_start("stage", stage, (void *)(intptr_t)k);
+    }
+    void *val;
+    for (long i = 0; co_chan_recv(stage_chan[nstage], &val); ++i) {
+        if (i % 64 == 0 && nsample < NSAMPLE) {
+            samples[nsample++] = (uintptr_t)now_ns() - (uintptr_t)val;
+        }
+    }
+    uint64_t ns = now_ns() - start;
+    for (int k = 0; k <= nstage; ++k) {
+        co_wait(thd[k]);
+        co_chan_free(stage_chan[k]);
+    }
+    report("pipeline",
+        "\"stages\":%d,\"cap\":%zu,\"items_per_s\":%.0f,"
+        "\"p50_latency_ns\":%llu,\"p99_latency_ns\":%llu",
+        nstage, cap, NITEMS / 4 / (ns / 1e9),
+        (unsigned long long)percentile(samples, nsample, 50),
+        (unsigned long long)percentile(samples, nsample, 99));
+}
+
+// -----------------------------------------------
+
+#define NCRUNCH 64
+
+static volatile uint64_t sink;
+
+static void crunch(void *arg) {
+    uint64_t x = (uintptr_t)arg;
+    for (int i = 0; i < 100; ++i) {
+        for (int j = 0; j < 100000; ++j) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        co_yield();
+    }
+    sink = x;
+}
+
+static void crunch_all(void *arg) {
+    struct co *thd[NCRUNCH];
+    for (int i = 0; i < NCRUNCH; ++i) {
+        thd[i] = co_start("crunch", crunch, (void *)(uintptr_t)i);
+    }
+    for (int i = 0; i < NCRUNCH; ++i) {
+        co_wait(thd[i]);
+    }
+}
+
+// CPU-bound coroutines under co_run() with a growing number of threads
+static void bench_threads(int nthreads) {
+    uint64_t start = now_ns();
+    co_run(nthreads, crunch_all, NULL);
+    uint64_t ns = now_ns() - start;
+    report("threads", "\"threads\":%d,\"ms\":%.1f", nthreads, ns / 1e6);
+}
+
+// -----------------------------------------------
+
+#define ECHO_ROUNDS 2000
+
+static int echo_fd;
+static struct sockaddr_in echo_addr;
+
+static void echo_conn(void *arg) {
+    int fd = (intptr_t)arg;
+    char buf[64];
+    ssize_t n;
+    while ((n = co_read(fd, buf, sizeof(buf))) > 0) {
+        co_write(fd, buf, n);
+    }
+    co_close(fd);
+}
+
+static void echo_server(void *arg) {
+    int nconn = (intptr_t)arg;
+    struct co **thd = malloc(nconn * sizeof(struct co *));
+    for (int i = 0; i < nconn; ++i) {
+        int fd = co_accept(echo_fd, NULL, NULL);
+        thd[i] = co_start("echo", echo_conn, (void *)(intptr_t)fd);
+    }
+    for (int i = 0; i < nconn; ++i) {
+        co_wait(thd[i]);
+    }
+    free(thd);
+}
+
+static void echo_client(void *arg) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    connect(fd, (struct sockaddr *)&echo_addr, sizeof(echo_addr));
+    char buf[64] = "ping";
+    for (int i = 0; i < ECHO_ROUNDS; ++i) {
+        co_write(fd, buf, sizeof(buf));
+        for (ssize_t got = 0; got < sizeof(buf); ) {
+            got += co_read(fd, buf + got, sizeof(buf) - got);
+        }
+    }
+    co_close(fd);
+}
+
+static void echo_all(void *arg) {
+    int nconn = (intptr_t)arg;
+    struct co **thd = malloc((nconn + 1) * sizeof(struct co *));
+    thd[0] = co_start("server", echo_server, arg);
+    for (int i = 1; i <= nconn; ++i) {
+        thd[i] = co_start("client", echo_client, NULL);
+    }
+    for (int i = 0; i <= nconn; ++i) {
+        co_wait(thd[i]);
+    }
+    free(thd);
+}
+
+// loopback echo server: nconn clients doing 64-byte round trips
+static void bench_echo(int nconn, int nthreads) {
+    echo_fd = socket(AF_INET, SOCK_STREAM, 0);
+    echo_addr.sin_family = AF_INET;
+    echo_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    echo_addr.sin_port = 0;
+    socklen_t len = sizeof(echo_addr);
+    bind(echo_fd, (struct sockaddr *)&echo_addr, len);
+    getsockname(echo_fd, (struct sockaddr *)&echo_addr, &len);
+    listen(echo_fd, nconn);
+    uint64_t start = now_ns();
+    if (nthreads) {
+        co_run(nthreads, echo_all, (void *)(intptr_t)nconn);
+    } else {
+        echo_all((void *)(intptr_t)nconn);
+    }
+    uint64_t ns = now_ns() - start;
+    co_close(echo_fd);
+    report("echo", "\"conns\":%d,\"threads\":%d,\"round_trips_per_s\":%.0f",
+        nconn, nthreads, (double)nconn * ECHO_ROUNDS / ns * 1e9);
+}
+
+// -----------------------------------------------
+
+#define NBATCH 4
+#define NREQ 20000
+
+static struct co_chan *req_chan;
+static int batch_running;
+static long batch_chunks;
+
+static void batch(void *arg) {
+    uint64_t x = (uintptr_t)arg;
+    for (long n = 0; batch_running; ++n) {
+        for (int j = 0; j < 5000; ++j) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        batch_chunks++;
+        // now and then a request arrives, stamped with its arrival time
+        if (n % 4 == 0) {
+            co_chan_send(req_chan, (void *)(uintptr_t)now_ns());
+        }
+        co_yield();
+    }
+    sink = x;
+}
+
+// NBATCH CPU-bound coroutines and one request handler at top priority:
+// how long does a request wait before it is handled?
+static void bench_policy(enum co_policy policy, const char *name) {
+    uint64_t *lat = malloc(NREQ * sizeof(uint64_t));
+    struct co *thd[NBATCH];
+    co_set_policy(policy);
+    req_chan = co_chan_new(0);
+    batch_running = 1;
+    batch_chunks = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < NBATCH; ++i) {
+        thd[i] = co_start("batch", batch, (void *)(uintptr_t)i);
+    }
+    // main handles the requests
+    co_set_priority(NULL, CO_PRIO_MAX);
+    for (int i = 0; i < NREQ; ++i) {
+        void *stamp;
+        co_chan_recv(req_chan, &stamp);
+        lat[i] = (uintptr_t)now_ns() - (uintptr_t)stamp;
+    }
+    co_set_priority(NULL, 0);
+    uint64_t ns = now_ns() - start;
+    batch_running = 0;
+    co_chan_close(req_chan);
+    for (int i = 0; i < NBATCH; ++i) {
+        co_wait(thd[i]);
+    }
+    co_chan_free(req_chan);
+    co_set_policy(CO_POLICY_RR);
+    uint64_t p50 = percentile(lat, NREQ, 50), p99 = percentile(lat, NREQ, 99);
+    report("policy",
+        "\"policy\":\"%s\",\"p50_latency_ns\":%llu,\"p99_latency_ns\":%llu,"
+        "\"max_latency_ns\":%llu,\"batch_per_s\":%.0f",
+        name, (unsigned long long)p50, (unsigned long long)p99,
+        (unsigned long long)lat[NREQ - 1], batch_chunks / (ns / 1e9));
+    free(lat);
+}
+
+static int selected(int argc, char *argv[], const char *bench) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], bench) == 0) return 1;
+    }
+    return argc < 2;
+}
+
+// usage: libco-bench-64 [bench ...], all of them by default
+int main(int argc, char *argv[]) {
+    if (selected(argc, argv, "spawn")) {
+        // each guarded stack is two mappings: stay below vm.max_map_count
+        bench_spawn(1000, 0, 0);
+        bench_spawn(10000, 0, 0);
+        bench_spawn(1000, 4096, 0);
+        bench_spawn(10000, 4096, 0);
+        // shared stacks need no mapping of their own
+        bench_spawn(10000, 0, 1);
+        bench_spawn(100000, 0, 1);
+    }
+
+    if (selected(argc, argv, "pingpong")) {
+        bench_switch(2, 0, 0);
+        bench_switch(2, 0, 1);
+    }
+
+    if (selected(argc, argv, "roundrobin")) {
+        for (int n = 4; n <= 4096; n *= 4) {
+            bench_switch(n, 0, 0);
+        }
+        bench_switch(12288, 0, 0);
+        bench_switch(12288, 4096, 0);
+        bench_switch(16, 0, 1);
+        bench_switch(12288, 0, 1);
+    }
+
+    if (selected(argc, argv, "churn")) {
+        bench_churn(1, 0);
+        bench_churn(64, 0);
+        bench_churn(4096, 0);
+        bench_churn(4096, 1);
+    }
+
+    if (selected(argc, argv, "group")) {
+        bench_group(1);
+        bench_group(64);
+        bench_group(4096);
+    }
+
+    if (selected(argc, argv, "chain")) {
+        for (int n = 10; n <= 10000; n *= 10) {
+            bench_chain(n);
+        }
+    }
+
+    if (selected(argc, argv, "pipe")) {
+        bench_pipe(0);
+        bench_pipe(1);
+    }
+
+    if (selected(argc, argv, "pipeline")) {
+        bench_pipeline(1, 1);
+        bench_pipeline(4, 16);
+        bench_pipeline(16, 16);
+        bench_pipeline(4, 0);
+    }
+
+    if (selected(argc, argv, "threads")) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int n = 1; n < ncpu; n *= 2) {
+            bench_threads(n);
+        }
+        bench_threads(ncpu);
+    }
+
+    if (selected(argc, argv, "echo")) {
+        for (int n = 1; n <= 256; n *= 16) {
+            bench_echo(n, 0);
+        }
+        bench_echo(256, 4);
+    }
+
+    if (selected(argc, argv, "policy")) {
+        bench_policy(CO_POLICY_RR, "rr");
+        bench_policy(CO_POLICY_PRIORITY, "priority");
+        bench_policy(CO_POLICY_FAIR, "fair");
+    }
+    return 0;
+}
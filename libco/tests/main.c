@@ -2,6 +2,11 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "co-test.h"
 
 int g_count = 0;
@@ -149,9 +154,373 @@ static void test_3() { //buggy
     }
 }
 
+// -----------------------------------------------
+
+#define NWORKER 64
+
+static long mt_count;
+
+static void spin(void *arg) {
+    for (int i = 0; i < 1000; ++i) {
+        __atomic_add_fetch(&mt_count, 1, __ATOMIC_RELAXED);
+        co_yield();
+    }
+}
+
+static void spawner(void *arg) {
+    struct co *thd[NWORKER];
+    for (int i = 0; i < NWORKER; ++i) {
+        thd[i] = co_start("spin", spin, NULL);
+    }
+    for (int i = 0; i < NWORKER; ++i) {
+        co_wait(thd[i]);
+    }
+}
+
+static void test_4() {
+    for (int nthreads = 1; nthreads <= 4; ++nthreads) {
+        mt_count = 0;
+        co_run(nthreads, spawner, NULL);
+        printf("%d threads: %ld\n", nthreads, mt_count);
+        assert(mt_count == NWORKER * 1000);
+    }
+}
+
+// -----------------------------------------------
+
+static struct co_chan *chan;
+static struct co_sem *sem;
+static long chan_sum, sem_inside;
+
+static void chan_producer(void *arg) {
+    for (long i = 1; i <= 100; ++i) {
+        co_chan_send(chan, (void *)i);
+    }
+}
+
+static void chan_consumer(void *arg) {
+    void *val;
+    while (co_chan_recv(chan, &val)) {
+        co_sem_wait(sem);
+        // at most 2 consumers in here at once
+        assert(__atomic_add_fetch(&sem_inside, 1, __ATOMIC_RELAXED) <= 2);
+        co_yield();
+        __atomic_sub_fetch(&sem_inside, 1, __ATOMIC_RELAXED);
+        co_sem_post(sem);
+        __atomic_add_fetch(&chan_sum, (long)val, __ATOMIC_RELAXED);
+    }
+}
+
+static void chan_test(void *arg) {
+    struct co *prod[4], *cons[4];
+    chan = co_chan_new((size_t)arg);
+    sem = co_sem_new(2);
+    chan_sum = 0;
+    for (int i = 0; i < 4; ++i) {
+        prod[i] = co_start("producer", chan_producer, NULL);
+        cons[i] = co_start("consumer", chan_consumer, NULL);
+    }
+    for (int i = 0; i < 4; ++i) {
+        co_wait(prod[i]);
+    }
+    co_chan_close(chan);
+    for (int i = 0; i < 4; ++i) {
+        co_wait(cons[i]);
+    }
+    co_chan_free(chan);
+    co_sem_free(sem);
+}
+
+static void test_5() {
+    chan_test((void *)10);
+    printf("bounded: %ld\n", chan_sum);
+    assert(chan_sum == 4 * 5050);
+    chan_test((void *)0);
+    printf("unbounded: %ld\n", chan_sum);
+    assert(chan_sum == 4 * 5050);
+    co_run(4, chan_test, (void *)1);
+    printf("4 threads: %ld\n", chan_sum);
+    assert(chan_sum == 4 * 5050);
+}
+
+// -----------------------------------------------
+
+static int io_fds[2];
+static long io_sum, io_slept;
+
+static void io_ping(void *arg) {
+    for (long i = 1; i <= 1000; ++i) {
+        long val;
+        assert(co_write(io_fds[0], &i, sizeof(i)) == sizeof(i));
+        assert(co_read(io_fds[0], &val, sizeof(val)) == sizeof(val));
+        assert(val == -i);
+    }
+    co_close(io_fds[0]);
+}
+
+static void io_pong(void *arg) {
+    long val;
+    while (co_read(io_fds[1], &val, sizeof(val)) == sizeof(val)) {
+        io_sum += val;
+        val = -val;
+        co_write(io_fds[1], &val, sizeof(val));
+    }
+    co_close(io_fds[1]);
+}
+
+static void io_sleeper(void *arg) {
+    co_sleep((uintptr_t)arg * 10000000);
+    // sleepers wake up in deadline order
+    assert(__atomic_add_fetch(&io_slept, 1, __ATOMIC_RELAXED) == (uintptr_t)arg);
+}
+
+static void io_test(void *arg) {
+    struct co *thd[6];
+    int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, io_fds);
+    assert(ret == 0);
+    for (int k = 0; arg && k < 2; ++k) {
+        // just below the hard limit, above the soft one libco started with
+        int fd = (intptr_t)arg - 1 - k;
+        assert(dup2(io_fds[k], fd) == fd);
+        close(io_fds[k]);
+        io_fds[k] = fd;
+    }
+    io_sum = io_slept = 0;
+    thd[0] = co_start("ping", io_ping, NULL);
+    thd[1] = co_start("pong", io_pong, NULL);
+    for (uintptr_t i = 4; i >= 1; --i) {
+        thd[6 - i] = co_start("sleeper", io_sleeper, (void *)i);
+    }
+    // the last sleeper is due in 40 ms
+    assert(co_wait_timeout(thd[2], 5000000) == -1);
+    assert(co_wait_timeout(thd[2], 1000000000) == 0);
+    for (int i = 0; i < 6; ++i) {
+        co_wait(thd[i]);
+    }
+}
+
+static void test_6() {
+    io_test(NULL);
+    printf("sum: %ld, slept: %ld\n", io_sum, io_slept);
+    assert(io_sum == 500500 && io_slept == 4);
+    co_run(2, io_test, NULL);
+    printf("2 threads: %ld, slept: %ld\n", io_sum, io_slept);
+    assert(io_sum == 500500 && io_slept == 4);
+
+    // main() lowered the soft limit; what was raised since must work
+    struct rlimit rl;
+    assert(getrlimit(RLIMIT_NOFILE, &rl) == 0);
+    rl.rlim_cur = rl.rlim_max;
+    assert(setrlimit(RLIMIT_NOFILE, &rl) == 0);
+    io_test((void *)(intptr_t)(rl.rlim_max < 65536 ? rl.rlim_max : 65536));
+    printf("high fds: %ld, slept: %ld\n", io_sum, io_slept);
+    assert(io_sum == 500500 && io_slept == 4);
+}
+
+// -----------------------------------------------
+
+static void stat_worker(void *arg) {
+    char buf[4096];
+    memset(buf, 1, sizeof(buf)); // at least 4 KiB of stack
+    for (int i = 0; i < 100; ++i) {
+        co_yield();
+    }
+    g_count += buf[0];
+}
+
+static void test_7() {
+    co_stats_enable(1);
+    struct co *thd[4];
+    struct co_stat st;
+    for (int i = 0; i < 4; ++i) {
+        thd[i] = co_start("stat_worker", stat_worker, NULL);
+    }
+    co_yield();
+    co_stat(thd[0], &st);
+    printf("1 switch, stack >= 4096: %llu, %zu\n",
+        (unsigned long long)st.switches, st.stack_peak);
+    assert(st.switches == 1 && st.stack_peak >= 4096);
+    for (int i = 0; i < 4; ++i) {
+        co_wait(thd[i]);
+    }
+    struct co_stats all;
+    co_stats(&all);
+    assert(all.spawns == 4 && all.yields >= 400);
+    co_stats_dump(1);
+    co_stats_enable(0);
+}
+
+// -----------------------------------------------
+
+static int prio_log[64], prio_len;
+static long fair_runs[2], fair_total;
+
+static void prio_worker(void *arg) {
+    for (int i = 0; i < 4; ++i) {
+        prio_log[prio_len++] = (intptr_t)arg;
+        co_yield();
+    }
+}
+
+static void fair_worker(void *arg) {
+    volatile long x = 0;
+    while (fair_total < 20000) {
+        for (int i = 0; i < 1000; ++i) {
+            x += i;
+        }
+        fair_runs[(intptr_t)arg]++;
+        fair_total++;
+        co_yield();
+    }
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long sleep_runs[2];
+
+static void fair_sleeper(void *arg) {
+    // the time nobody ran is nobody's slice
+    int id = (intptr_t)arg;
+    co_sleep((300 + 10 * id) * 1000000ull);
+    for (double end = now_sec() + 0.2; now_sec() < end; ) {
+        sleep_runs[id]++;
+        co_yield();
+    }
+}
+
+static void test_8() {
+    struct co *thd[8];
+    struct co_attr attr = { .priority = 5 };
+    co_set_policy(CO_POLICY_PRIORITY);
+    for (int i = 0; i < 8; ++i) {
+        // started low first, yet the high ones run first
+        attr.priority = i < 4 ? 0 : 5;
+        thd[i] = co_start_ex("prio", prio_worker, (void *)(intptr_t)(i >= 4), &attr);
+    }
+    for (int i = 0; i < 8; ++i) {
+        co_wait(thd[i]);
+    }
+    for (int i = 0; i < 32; ++i) {
+        assert(prio_log[i] == (i < 16));
+    }
+    printf("priority: ok\n");
+
+    co_set_policy(CO_POLICY_FAIR);
+    for (int i = 0; i < 2; ++i) {
+        attr.priority = 2 * i; // weights 1 and 4
+        thd[i] = co_start_ex("fair", fair_worker, (void *)(intptr_t)i, &attr);
+    }
+    co_wait(thd[0]);
+    co_wait(thd[1]);
+    printf("fair: %ld vs %ld\n", fair_runs[0], fair_runs[1]);
+    assert(fair_runs[1] > 2 * fair_runs[0]);
+
+    for (int i = 0; i < 2; ++i) {
+        attr.priority = 0;
+        thd[i] = co_start_ex("fair", fair_sleeper, (void *)(intptr_t)i, &attr);
+    }
+    co_wait(thd[0]);
+    co_wait(thd[1]);
+    printf("fair after sleeping: %ld vs %ld\n", sleep_runs[0], sleep_runs[1]);
+    assert(sleep_runs[0] < 2 * sleep_runs[1] && sleep_runs[1] < 2 * sleep_runs[0]);
+    co_set_policy(CO_POLICY_RR);
+}
+
+// -----------------------------------------------
+
+static long shared_sum;
+
+static int shared_depth(int id, int depth) {
+    // frames on the shared stack survive the others running meanwhile
+    int buf[32];
+    for (int i = 0; i < 32; ++i) {
+        buf[i] = id * depth + i;
+    }
+    co_yield();
+    int sum = depth ? shared_depth(id, depth - 1) : 0;
+    for (int i = 0; i < 32; ++i) {
+        assert(buf[i] == id * depth + i);
+    }
+    return sum + 1;
+}
+
+static void shared_worker(void *arg) {
+    int id = (intptr_t)arg;
+    shared_sum += shared_depth(id, id % 8);
+}
+
+static void test_9() {
+    struct co_attr attr = { .shared_stack = 1 };
+    struct co *thd[1000];
+    for (int round = 0; round < 2; ++round) {
+        shared_sum = 0;
+        for (int i = 0; i < 1000; ++i) {
+            // mixed with coroutines on stacks of their own
+            thd[i] = i % 4 ? co_start_ex("shared", shared_worker, (void *)(intptr_t)i, &attr)
+                           : co_start("own", shared_worker, (void *)(intptr_t)i);
+        }
+        for (int i = 0; i < 1000; ++i) {
+            co_wait(thd[i]);
+        }
+        printf("round %d: %ld\n", round, shared_sum);
+        assert(shared_sum == 4500);
+    }
+}
+
+// -----------------------------------------------
+
+static long group_sum;
+
+static void group_leaf(void *arg) {
+    co_yield();
+    __atomic_add_fetch(&group_sum, (intptr_t)arg, __ATOMIC_RELAXED);
+}
+
+static void group_fork(void *arg) {
+    // nested: every member joins a group of its own
+    struct co_group *g = co_group_new();
+    co_group_spawn(g, "leaf", 1000, group_leaf, NULL, NULL);
+    co_group_wait(g);
+    co_group_free(g);
+}
+
+static void group_test(void *arg) {
+    struct co_group *g = co_group_new();
+    void *args[10];
+    for (int round = 0; round < 2; ++round) {
+        group_sum = 0;
+        for (int i = 0; i < 10; ++i) {
+            args[i] = (void *)(intptr_t)i;
+        }
+        co_group_spawn(g, "fork", 10, group_fork, args, NULL);
+        co_group_spawn(g, "leaf", 10, group_leaf, args, NULL);
+        co_group_wait(g);
+        assert(group_sum == 10 * 499500 + 45);
+    }
+    co_group_wait(g); // nothing left to wait for
+    co_group_free(g);
+}
+
+static void test_10() {
+    group_test(NULL);
+    printf("single: %ld\n", group_sum);
+    co_run(4, group_test, NULL);
+    printf("4 threads: %ld\n", group_sum);
+}
+
 int main() {
     setbuf(stdout, NULL);
 
+    // before libco sizes its fd table, see test_6
+    struct rlimit rl;
+    assert(getrlimit(RLIMIT_NOFILE, &rl) == 0);
+    if (rl.rlim_cur > 64) rl.rlim_cur = 64;
+    assert(setrlimit(RLIMIT_NOFILE, &rl) == 0);
+
     // printf("Test #1. Expect: (X|Y){0, 1, 2, ..., 199}\n");
     // test_1();
 
@@ -161,6 +530,27 @@ int main() {
     printf("\n\nTest #3.\n");
     test_3();
 
+    printf("\n\nTest #4. Expect: 64000 on each line\n");
+    test_4();
+
+    printf("\n\nTest #5. Expect: 20200 on each line\n");
+    test_5();
+
+    printf("\n\nTest #6. Expect: 500500, slept 4\n");
+    test_6();
+
+    printf("\n\nTest #7. Expect: 4 stat_worker finished, 101 switches each\n");
+    test_7();
+
+    printf("\n\nTest #8. Expect: about 4 times as many runs for the second, then about as many\n");
+    test_8();
+
+    printf("\n\nTest #9. Expect: 4500 on each line\n");
+    test_9();
+
+    printf("\n\nTest #10. Expect: 4995045 on each line\n");
+    test_10();
+
     printf("\n\n");
 
     return 0;
@@ -1,26 +1,70 @@
+#define _GNU_SOURCE
 #include <assert.h>
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <langinfo.h>
+#include <locale.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
 
 static struct option long_options[] = {
+  {"ascii",         no_argument,  0,  'A'},
+  {"compact-not",   no_argument,  0,  'c'},
   {"numeric-sort",  no_argument,  0,  'n'},
+  {"show-threads",  no_argument,  0,  't'},
   {"show-pids",     no_argument,  0,  'p'},
+  {"resources",     no_argument,  0,  'r'},
+  {"sort",    required_argument,  0,  'S'},
+  {"unicode",       no_argument,  0,  'U'},
   {"version",       no_argument,  0,  'V'},
+  {"threads", required_argument,  0,  'j'},
+  {"watch",   required_argument,  0,  'W'},
+  {"bench",   optional_argument,  0,  'B'},
+  {"dump",    required_argument,  0,  'D'},
+  {"load",    required_argument,  0,  'L'},
+  {"diff",    required_argument,  0,  'O'},
   {0,               0,            0,   0 }
 };
 
 static char Usage[] = 
-"Usage: pstree [ -p ] [ -n ]\n\
-   or: pstree -V\n\n\
+"Usage: pstree [ -A | -U ] [ -c ] [ -p ] [ -r ] [ -t ] [ -n | --sort=KEY ] [ -j N ]\n\
+   or: pstree --watch=SEC [ -A | -U ] [ -c ] [ -p ] [ -n ]\n\
+   or: pstree --dump=FILE [ -t ] [ -j N ]\n\
+   or: pstree --load=FILE [ --diff=OLD ] [ -A | -U ] [ -c ] [ -p ] [ -r ] [ -n | --sort=KEY ]\n\
+   or: pstree --diff=OLD [ -A | -U ] [ -c ] [ -p ] [ -n ]\n\
+   or: pstree -V\n\
+   or: pstree --bench[=N]\n\n\
 Display a tree of processes.\n\n\
+  -A, --ascii         use ASCII line drawing characters\n\
+  -c, --compact-not   don't compact identical subtrees\n\
   -n, --numeric-sort  sort output by PID\n\
   -p, --show-pids     show PIDs; implies -c\n\
-  -V, --version       display version information\n";
+  -r, --resources     show RSS, CPU time and threads, own/subtree; implies -c\n\
+  -t, --show-threads  show threads in braces, not with --watch\n\
+      --sort=KEY      order sons by name, pid, or subtree rss, cpu, threads\n\
+  -j, --threads=N     read /proc on N threads (default: one per core)\n\
+  -U, --unicode       use UTF-8 line drawing characters\n\
+  -V, --version       display version information\n\
+      --watch=SEC     print the tree, then what forks and exits every SEC\n\
+      --bench[=N]     time scanning /proc, or a fake one of N processes\n\
+      --dump=FILE     save the processes to FILE instead of printing them\n\
+      --load=FILE     print the processes saved in FILE, not those running\n\
+      --diff=OLD      print what exited and forked since OLD was saved\n";
 
 static char version[] =
 "pstree (PSmisc) UNKNOWN\n\
@@ -30,7 +74,7 @@ This is free software, and you are welcome to redistribute it under\n\
 the terms of the GNU General Public License.\n\
 For more information about these matters, see the files named COPYING.\n";
 
-int isnumber(const char *name) {
+static int isnumber(const char *name) {
   for (int i = 0; name[i] != '\0'; ++i) {
     if (name[i] < '0' || name[i] > '9')
       return 0;
@@ -38,140 +82,1380 @@ int isnumber(const char *name) {
   return 1;
 }
 
+struct usage {
+  uint64_t rss;     // bytes
+  uint64_t cpu;     // clock ticks, user + system
+  uint64_t threads;
+};
+
+// one <pid>/stat as read_stat() parses it, before it joins the table;
+// comm is 15 bytes at most, so name only cuts fakes
 struct proc {
-  char name[256];
+  char name[64];
   pid_t pid;
   pid_t ppid;
-  int son;
-  int brother;
+  uint8_t flags;
+  uint64_t start;   // clock ticks after boot, tells a reused pid apart
+  struct usage own;
 };
 
-#define MAXN 1 << 16
-static int root, tap;
-static struct proc plist[MAXN];
+enum {
+  F_HIDDEN = 1, // a kernel thread, left out of the tree
+  F_THREAD = 2, // -t: a thread other than the main one, ppid is its tgid
+};
 
-int c, nflag, pflag;
+// the process table, one array per field, so that each pass pulls in
+// only what it reads; names live in one arena, see pt_add()
+struct table {
+  int n, cap;
+  pid_t *pid, *ppid;
+  int *son, *brother;
+  int *last_son;      // where the next son is appended
+  uint32_t *name;     // offset into names
+  uint8_t *flags;
+  uint8_t *mark;      // --watch and --diff, see enum mark
+  uint64_t *start;    // --watch and --diff
+  struct usage *own, *sub; // sub: own plus the sons' sub, see rollup()
+  struct {
+    char *buf;
+    size_t len, cap;
+    size_t dead; // bytes of names no entry points to any more
+  } names;
+  void *map;          // --load: own, start, pid, ppid, name, flags, names
+  size_t map_len;
+};
+static struct table pt;
 
-void print(int n) {
-  for (int i = 0; i < tap; ++i) {
-    printf("\t");
+#define NAME(i) (pt.names.buf + pt.name[i])
+
+static int root;
+
+int c, pflag, cflag, rflag, tflag;
+
+// how sons are ordered: by name, pid, or subtree usage, largest first
+enum sort_key { SORT_NAME, SORT_PID, SORT_RSS, SORT_CPU, SORT_THREADS };
+static const char *sort_keys[] = { "name", "pid", "rss", "cpu", "threads" };
+static enum sort_key skey;
+int jflag;       // scan() threads
+int bflag = -1; // --bench[=N]
+double wflag;   // --watch=SEC
+const char *dflag, *lflag, *oflag; // --dump, --load, --diff FILE
+
+static const char *parse_int(const char *s, int *val) {
+  int x = 0;
+  while (*s >= '0' && *s <= '9') x = x * 10 + (*s++ - '0');
+  *val = x;
+  return s;
+}
+
+static const char *parse_u64(const char *s, uint64_t *val) {
+  uint64_t x = 0;
+  while (*s >= '0' && *s <= '9') x = x * 10 + (*s++ - '0');
+  *val = x;
+  return s;
+}
+
+// past n space separated fields
+static const char *skip_fields(const char *s, int n) {
+  for (; n > 0 && *s; --n) {
+    while (*s && *s != ' ') s++;
+    if (*s) s++;
   }
-  if (pflag) 
-    printf("%s(%d)\n", plist[n].name, plist[n].pid);
-  else 
-    printf("%s\n", plist[n].name);
-  
-  if (plist[n].son != -1) {
-    tap++;
-    print(plist[n].son);
-    tap--;
+  return s;
+}
+
+static void pt_reserve(int n) {
+  if (n <= pt.cap) return;
+  while (pt.cap < n) pt.cap = pt.cap ? pt.cap * 2 : 1024;
+#define GROW(a) (pt.a = realloc(pt.a, pt.cap * sizeof(*pt.a)), assert(pt.a))
+  GROW(pid); GROW(ppid); GROW(son); GROW(brother); GROW(last_son);
+  GROW(name); GROW(flags); GROW(mark); GROW(start); GROW(own); GROW(sub);
+#undef GROW
+}
+
+static uint32_t names_add(const char *name) {
+  size_t len = strlen(name) + 1;
+  if (pt.names.len + len > pt.names.cap) {
+    while (pt.names.len + len > pt.names.cap) {
+      pt.names.cap = pt.names.cap ? pt.names.cap * 2 : 1 << 16;
+    }
+    pt.names.buf = realloc(pt.names.buf, pt.names.cap);
+    assert(pt.names.buf);
   }
+  memcpy(pt.names.buf + pt.names.len, name, len);
+  pt.names.len += len;
+  assert(pt.names.len <= UINT32_MAX);
+  return pt.names.len - len;
+}
+
+// append p to the table, returning its index
+static int pt_add(const struct proc *p) {
+  pt_reserve(pt.n + 1);
+  int i = pt.n++;
+  pt.pid[i] = p->pid;
+  pt.ppid[i] = p->ppid;
+  pt.name[i] = names_add(p->name);
+  pt.flags[i] = p->flags;
+  pt.mark[i] = 0;
+  pt.start[i] = p->start;
+  pt.own[i] = p->own;
+  return i;
+}
+
+// drop the names no entry points to, once they are most of the arena
+static void names_compact() {
+  if (pt.names.dead < (1 << 16) || pt.names.dead < pt.names.len / 2) return;
+  char *old = pt.names.buf;
+  pt.names.buf = NULL;
+  pt.names.len = pt.names.cap = pt.names.dead = 0;
+  for (int i = 0; i < pt.n; ++i) pt.name[i] = names_add(old + pt.name[i]);
+  free(old);
+}
+
+static void pt_clear() {
+  pt.n = 0;
+  pt.names.len = pt.names.dead = 0;
+}
+
+// /proc/<pid>/stat in a single read(): "pid (comm) state ppid ...",
+// where comm may hold spaces and parentheses itself, so it ends at the
+// last ')'; it has the usage too, so statm is not needed; returns -1 if
+// the process is gone
+static int read_stat(int dirfd, pid_t pid, struct proc *p) {
+  char buf[4096], path[32], *s = path + 16;
+  memcpy(s, "/stat", sizeof("/stat"));
+  do *--s = '0' + pid % 10; while (pid /= 10);
+
+  int fd = openat(dirfd, s, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  ssize_t n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (n <= 0) return -1;
+  buf[n] = '\0';
 
-  if (plist[n].brother != -1) {
-    print(plist[n].brother);
+  char *lp = memchr(buf, '(', n), *rp = memrchr(buf, ')', n);
+  if (!lp || !rp || rp < lp || rp + 4 > buf + n) return -1;
+  parse_int(buf, &p->pid);
+  size_t len = rp - lp - 1;
+  if (len >= sizeof(p->name)) len = sizeof(p->name) - 1;
+  memcpy(p->name, lp + 1, len);
+  p->name[len] = '\0';
+  // fields 4, 14, 15, 20, 22 and 24 of proc(5)
+  static long page_size;
+  if (!page_size) page_size = sysconf(_SC_PAGESIZE);
+  uint64_t utime, stime;
+  const char *f = parse_int(rp + 4, &p->ppid); // skip ") S "
+  f = parse_u64(skip_fields(f + 1, 9), &utime);
+  f = parse_u64(f + 1, &stime);
+  f = parse_u64(skip_fields(f + 1, 4), &p->own.threads);
+  f = parse_u64(skip_fields(f + 1, 1), &p->start);
+  f = parse_u64(skip_fields(f + 1, 1), &p->own.rss);
+  p->own.cpu = utime + stime;
+  p->own.rss *= page_size;
+  p->flags = p->pid == 2 || p->ppid == 2 ? F_HIDDEN : 0;
+  return 0;
+}
+
+// the /proc entries to read, shared out to the workers CHUNK at a time
+#define CHUNK 256
+static struct {
+  int    dfd;
+  pid_t *pids;
+  int    npid, cap;
+  int    next;
+} job;
+
+// what one worker has read, merged into the table by scan()
+struct slab {
+  pthread_t    thread;
+  struct proc *v;
+  int          n, cap;
+};
+static struct slab *slabs;
+static int nslab;
+
+static struct proc *slab_next(struct slab *sl) {
+  if (sl->n == sl->cap) {
+    sl->cap = sl->cap ? sl->cap * 2 : CHUNK;
+    sl->v = realloc(sl->v, sl->cap * sizeof(struct proc));
+    assert(sl->v);
   }
+  return &sl->v[sl->n];
 }
 
-int main(int argc, char *argv[]) {
+// -t: the threads of pid but its main one, as its sons
+static void scan_tasks(struct slab *sl, pid_t pid) {
+  char path[32];
+  snprintf(path, sizeof(path), "%d/task", pid);
+  int fd = openat(job.dfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return;
+  DIR *dp = fdopendir(fd);
+  assert(dp);
+  struct dirent *de;
+  while ( (de = readdir(dp)) ) {
+    if (!isnumber(de->d_name)) continue;
+    pid_t tid = atoi(de->d_name);
+    struct proc *p = slab_next(sl);
+    if (tid == pid || read_stat(fd, tid, p) < 0) continue;
+    p->ppid = pid;
+    p->flags = F_THREAD;
+    memset(&p->own, 0, sizeof(p->own)); // counted in the process
+    sl->n++;
+  }
+  closedir(dp);
+}
 
-  // getopt
-  while ((c = getopt_long(argc, argv, "npV", long_options, 0)) != -1) {
-    switch (c) {
-      case 'n': nflag = 1; break;
-      case 'p': pflag = 1; break;
-      case 'V': fprintf(stderr, "%s", version); return 0;
-      case '?': fprintf(stderr, "%s", Usage); return 0;
-      default:  return 1;
+static void *scan_worker(void *arg) {
+  struct slab *sl = arg;
+  sl->n = 0;
+  for (;;) {
+    int i = __atomic_fetch_add(&job.next, CHUNK, __ATOMIC_RELAXED);
+    if (i >= job.npid) break;
+    int end = i + CHUNK < job.npid ? i + CHUNK : job.npid;
+    for (; i < end; ++i) {
+      struct proc *p = slab_next(sl);
+      if (read_stat(job.dfd, job.pids[i], p) < 0) continue;
+      sl->n++;
+      if (tflag && p->own.threads > 1 && !(p->flags & F_HIDDEN)) {
+        scan_tasks(sl, job.pids[i]);
+      }
     }
   }
+  return NULL;
+}
 
-  if (optind < argc) {
-    printf("non-option ARGV-elements: ");
-    while (optind < argc)
-      printf("%s ", argv[optind++]);
-    printf("\n");
+// every <pid> entry of dp into job.pids
+static void list_pids(DIR *dp) {
+  struct dirent *de;
+  rewinddir(dp);
+  job.npid = 0;
+  while ( (de = readdir(dp)) ) {
+    if (!isnumber(de->d_name)) continue;
+    if (job.npid == job.cap) {
+      job.cap = job.cap ? job.cap * 2 : 1024;
+      job.pids = realloc(job.pids, job.cap * sizeof(pid_t));
+      assert(job.pids);
+    }
+    job.pids[job.npid++] = atoi(de->d_name);
+  }
+}
+
+// fill the table from every <pid>/stat under dir, kernel threads hidden, on
+// up to jflag threads; build() sorts, so the order they finish in does
+// not show
+static int scan(const char *dir) {
+  DIR *dp = opendir(dir);
+  assert(dp);
+  job.dfd = dirfd(dp);
+  list_pids(dp);
+
+  // no more threads than chunks, the calling one included
+  int n = jflag < (job.npid + CHUNK - 1) / CHUNK ? jflag
+                                                  : (job.npid + CHUNK - 1) / CHUNK;
+  if (n < 1) n = 1;
+  if (n > nslab) {
+    slabs = realloc(slabs, n * sizeof(struct slab));
+    assert(slabs);
+    memset(slabs + nslab, 0, (n - nslab) * sizeof(struct slab));
+    nslab = n;
+  }
+  job.next = 0;
+  for (int i = 1; i < n; ++i) {
+    int ret = pthread_create(&slabs[i].thread, NULL, scan_worker, &slabs[i]);
+    assert(ret == 0);
+  }
+  scan_worker(&slabs[0]);
+  for (int i = 1; i < n; ++i) {
+    pthread_join(slabs[i].thread, NULL);
+  }
+  closedir(dp);
+
+  int total = 0;
+  for (int i = 0; i < n; ++i) total += slabs[i].n;
+  pt_clear();
+  pt_reserve(total);
+  for (int i = 0; i < n; ++i) {
+    for (int k = 0; k < slabs[i].n; ++k) pt_add(&slabs[i].v[k]);
+  }
+  return pt.n;
+}
+
+// what build() sorts: key orders most pairs without touching the table,
+// the pid for -n, the usage complemented for largest first, or else the
+// first 8 bytes of the name, big-endian; by name, threads come after the
+// processes, as psmisc sorts them by "{name}"
+struct order {
+  uint64_t key;
+  int i;
+  int thread;
+};
+
+static uint64_t name_key(const char *name) {
+  uint64_t key = 0;
+  int i = 0;
+  for (; i < 8 && name[i]; ++i) key = key << 8 | (unsigned char)name[i];
+  return key << (8 * (8 - i));
+}
+
+static int cmp_order(const void *a, const void *b) {
+  const struct order *x = a, *y = b;
+  if (x->thread != y->thread) return x->thread - y->thread;
+  if (x->key != y->key) return x->key < y->key ? -1 : 1;
+  if (skey != SORT_PID) {
+    int r = strcmp(NAME(x->i), NAME(y->i));
+    if (r) return r;
+  }
+  pid_t p = pt.pid[x->i], q = pt.pid[y->i];
+  return (p > q) - (p < q);
+}
+
+// open addressing from pid to table index, at most half full
+static int *ptab;
+static unsigned pmask;
+
+static int *pid_slot(pid_t pid) {
+  unsigned h = (unsigned)pid * 2654435761u;
+  for (;; ++h) {
+    int *slot = &ptab[h & pmask];
+    if (*slot == -1 || pt.pid[*slot] == pid) return slot;
+  }
+}
+
+static uint64_t sort_key(int i) {
+  switch (skey) {
+    case SORT_NAME:    return name_key(NAME(i));
+    case SORT_PID:     return pt.pid[i];
+    case SORT_RSS:     return ~pt.sub[i].rss;
+    case SORT_CPU:     return ~pt.sub[i].cpu;
+    case SORT_THREADS: return ~pt.sub[i].threads;
+  }
+  return 0;
+}
+
+// .brother = the next proc whose ppid is the same
+// .son = the first proc whose ppid equals its pid
+static void link_sons(struct order *order) {
+  root = -1;
+  for (int i = 0; i < pt.n; ++i) pt.son[i] = pt.brother[i] = -1;
+  for (int k = 0; k < pt.n; ++k) {
+    int i = order[k].i;
+    if (pt.flags[i] & F_HIDDEN) continue;
+    // root of pstree
+    if (pt.ppid[i] == 0) {
+      root = i;
+      continue;
+    }
+
+    int j = *pid_slot(pt.ppid[i]);
+    if (j == -1) continue; // its parent is gone already
+    if (pt.son[j] == -1) pt.son[j] = i;
+    else pt.brother[pt.last_son[j]] = i;
+    pt.last_son[j] = i;
+  }
+}
+
+// sub of every node of the tree, in one post-order pass: a preorder
+// walk, summed up in reverse
+static void rollup() {
+  static int *pre;
+  static int cap;
+  if (cap < pt.n + 1) {
+    cap = pt.n + 1;
+    pre = realloc(pre, cap * sizeof(int));
+    assert(pre);
+  }
+  if (root == -1) return;
+  int n = 0, top = cap; // preorder grows up, the walk stack down
+  pre[--top] = root;
+  while (top < cap) {
+    int i = pre[top++];
+    pre[n++] = i;
+    pt.sub[i] = pt.own[i];
+    for (int c = pt.son[i]; c != -1; c = pt.brother[c]) pre[--top] = c;
+  }
+  for (int k = n - 1; k > 0; --k) {
+    struct usage *p = &pt.sub[pre[k]], *q = &pt.sub[*pid_slot(pt.ppid[pre[k]])];
+    q->rss += p->rss;
+    q->cpu += p->cpu;
+    q->threads += p->threads;
+  }
+}
+
+// link each process under its parent in O(1), in sorted order so that
+// appending keeps every son list sorted
+static void build() {
+  static struct order *order;
+  unsigned size = 16;
+  while (size < 2u * pt.n) size *= 2;
+  if (size - 1 > pmask) {
+    free(ptab);
+    free(order);
+    ptab = malloc(size * sizeof(int));
+    order = malloc(size / 2 * sizeof(struct order));
+    assert(ptab && order);
+  }
+  pmask = size - 1;
+  memset(ptab, -1, size * sizeof(int));
+  for (int i = 0; i < pt.n; ++i) {
+    *pid_slot(pt.pid[i]) = i;
+    order[i].i = i;
+  }
+  if (skey >= SORT_RSS) {
+    // the keys are subtree totals, which need a tree first
+    link_sons(order);
+    rollup();
+  }
+  for (int i = 0; i < pt.n; ++i) {
+    order[i].key = sort_key(order[i].i);
+    order[i].thread = skey == SORT_NAME && (pt.flags[order[i].i] & F_THREAD);
+  }
+  qsort(order, pt.n, sizeof(struct order), cmp_order);
+  link_sons(order);
+  if (rflag && skey < SORT_RSS) rollup();
+}
+
+// --bench=N: a fake /proc of pids 1, 3, 4, ... under a random tree,
+// with names that trip naive parsers
+static void fake_name(char *name, size_t size, int pid) {
+  switch (pid % 4) {
+    case 0:  snprintf(name, size, "worker %d", pid); break;
+    case 1:  snprintf(name, size, "a) b (%d", pid); break;
+    case 2:  snprintf(name, size, "(sd-%d))", pid); break;
+    default: snprintf(name, size, "proc%d", pid); break;
+  }
+}
+
+static int fake_pid(int i) {
+  return i ? i + 2 : 1; // not 2, which scan() leaves out
+}
+
+static void fake_proc(const char *dir, int n) {
+  int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+  assert(dfd >= 0);
+  srand(n);
+  for (int i = 0; i < n; ++i) {
+    char path[64], name[64], line[512];
+    int pid = fake_pid(i), ppid = i ? fake_pid(rand() % i) : 0;
+    snprintf(path, sizeof(path), "%d", pid);
+    int ret = mkdirat(dfd, path, 0755);
+    assert(ret == 0);
+    strcat(path, "/stat");
+    int fd = openat(dfd, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    fake_name(name, sizeof(name), pid);
+    // the length and shape of a real one
+    int len = snprintf(line, sizeof(line),
+      "%d (%s) S %d %d %d 0 -1 4194560 1024 0 0 0 5 3 0 0 20 0 1 0 %d "
+      "17000000 512 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 "
+      "0 0 0 0 0 0 0 0 0 0 0 0 0 0\n", pid, name, ppid, pid, pid, i);
+    ret = write(fd, line, len);
+    assert(ret == len);
+    close(fd);
+  }
+  close(dfd);
+}
+
+static void fake_proc_remove(const char *dir, int n) {
+  int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+  assert(dfd >= 0);
+  for (int i = 0; i < n; ++i) {
+    char path[64];
+    snprintf(path, sizeof(path), "%d/stat", fake_pid(i));
+    unlinkat(dfd, path, 0);
+    *strchr(path, '/') = '\0';
+    unlinkat(dfd, path, AT_REMOVEDIR);
+  }
+  close(dfd);
+  rmdir(dir);
+}
+
+static double now_sec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// line drawing, as psmisc does it
+struct symbols {
+  const char *empty_2, *branch_2, *vert_2, *last_2, *single_3, *first_3;
+};
+static const struct symbols sym_ascii = {
+  "  ", "|-", "| ", "`-", "---", "-+-",
+};
+static const struct symbols sym_utf8 = {
+  "  ", "\u251c\u2500", "\u2502 ", "\u2514\u2500",
+  "\u2500\u2500\u2500", "\u2500\u252c\u2500",
+};
+static const struct symbols *sym = &sym_ascii;
+
+// the whole tree is rendered here, then written at once
+static struct {
+  char *buf;
+  size_t len, cap;
+} out;
+
+static void out_bytes(const char *s, size_t n) {
+  if (out.len + n > out.cap) {
+    while (out.len + n > out.cap) out.cap = out.cap ? out.cap * 2 : 1 << 16;
+    out.buf = realloc(out.buf, out.cap);
+    assert(out.buf);
+  }
+  memcpy(out.buf + out.len, s, n);
+  out.len += n;
+}
+
+static void out_str(const char *s) {
+  out_bytes(s, strlen(s));
+}
+
+static void out_spaces(int n) {
+  static const char sp[] = "                                ";
+  for (; n > 0; n -= sizeof(sp) - 1) {
+    out_bytes(sp, n < (int)sizeof(sp) - 1 ? n : (int)sizeof(sp) - 1);
+  }
+}
+
+// columns of a UTF-8 string, one per character
+static int out_cols(const char *s, size_t n) {
+  int cols = 0;
+  for (size_t i = 0; i < n; ++i) cols += ((unsigned char)s[i] & 0xc0) != 0x80;
+  return cols;
+}
+
+// the buffer to fd and empty it; -1 if it did not all go
+static int out_write(int fd) {
+  size_t off = 0;
+  while (off < out.len) {
+    ssize_t n = write(fd, out.buf + off, out.len - off);
+    if (n <= 0) break;
+    off += n;
+  }
+  int ret = off == out.len ? 0 : -1;
+  out.len = 0;
+  return ret;
+}
+
+static void out_flush() {
+  fflush(stdout); // what was printf()ed goes first
+  out_write(STDOUT_FILENO);
+}
+
+static int fmt_size(char *s, size_t n, uint64_t bytes) {
+  const char *unit = "KMGTP";
+  double v = bytes / 1024.0;
+  for (; v >= 1024 && unit[1]; ++unit) v /= 1024;
+  return snprintf(s, n, v < 10 ? "%.1f%c" : "%.0f%c", v, *unit);
+}
+
+static int fmt_cpu(char *s, size_t n, uint64_t ticks) {
+  static long hz;
+  if (!hz) hz = sysconf(_SC_CLK_TCK);
+  double sec = (double)ticks / hz;
+  if (sec < 60) return snprintf(s, n, "%.1fs", sec);
+  uint64_t m = sec / 60;
+  if (m < 60) return snprintf(s, n, "%um%02us", (unsigned)m, (unsigned)sec % 60);
+  return snprintf(s, n, "%uh%02um", (unsigned)(m / 60), (unsigned)(m % 60));
+}
+
+// -r: " [rss cpu threads]", each as own/subtree where there are sons
+static void out_usage(int i) {
+  struct usage *own = &pt.own[i], *sub = &pt.sub[i];
+  char buf[128];
+  int k = 0, sons = pt.son[i] != -1;
+  k += snprintf(buf + k, sizeof(buf) - k, " [");
+  k += fmt_size(buf + k, sizeof(buf) - k, own->rss);
+  if (sons) k += snprintf(buf + k, sizeof(buf) - k, "/");
+  if (sons) k += fmt_size(buf + k, sizeof(buf) - k, sub->rss);
+  k += snprintf(buf + k, sizeof(buf) - k, " ");
+  k += fmt_cpu(buf + k, sizeof(buf) - k, own->cpu);
+  if (sons) k += snprintf(buf + k, sizeof(buf) - k, "/");
+  if (sons) k += fmt_cpu(buf + k, sizeof(buf) - k, sub->cpu);
+  k += snprintf(buf + k, sizeof(buf) - k, " %u", (unsigned)own->threads);
+  if (sons) k += snprintf(buf + k, sizeof(buf) - k, "/%u", (unsigned)sub->threads);
+  k += snprintf(buf + k, sizeof(buf) - k, "]");
+  out_bytes(buf, k);
+}
+
+// whether the subtrees at a and b print the same, pids aside
+static int tree_equal(int a, int b) {
+  static int *stk;
+  static int cap;
+  if (pt.flags[a] != pt.flags[b] || strcmp(NAME(a), NAME(b))) return 0;
+  int n = 0;
+  if (cap < 2) {
+    cap = 64;
+    stk = realloc(stk, cap * sizeof(int));
+    assert(stk);
+  }
+  stk[n++] = pt.son[a];
+  stk[n++] = pt.son[b];
+  while (n) {
+    int y = stk[--n], x = stk[--n];
+    for (; x != -1 && y != -1; x = pt.brother[x], y = pt.brother[y]) {
+      if (pt.flags[x] != pt.flags[y] || strcmp(NAME(x), NAME(y))) return 0;
+      if (n + 2 > cap) {
+        cap *= 2;
+        stk = realloc(stk, cap * sizeof(int));
+        assert(stk);
+      }
+      stk[n++] = pt.son[x];
+      stk[n++] = pt.son[y];
+    }
+    if (x != y) return 0; // one has more sons
   }
+  return 1;
+}
+
+// render() keeps its own stack, so neither depth nor width is limited
+// by the C one; a frame is a node whose sons are being printed
+struct frame {
+  int node, next; // next: the son to print after the current one
+  int closing;    // ']'s owed at the end of the last line of the subtree
+};
+
+static void render(int n) {
+  static struct frame *stk;
+  static int *width;  // columns of the label at each level
+  static char *more;  // the node at each level has brothers to come
+  static int cap;
+  int depth = 0, leaf = 1, last = 1, rep = 1, closing = 0;
+
+  for (;;) {
+    // n: at depth, rep times, first son of its parent unless !leaf
+    if (depth >= cap) {
+      cap = cap ? cap * 2 : 64;
+      stk = realloc(stk, cap * sizeof(struct frame));
+      width = realloc(width, cap * sizeof(int));
+      more = realloc(more, cap);
+      assert(stk && width && more);
+    }
+    if (!leaf) {
+      out_bytes("\n", 1);
+      for (int l = 0; l < depth; ++l) {
+        out_spaces(width[l] + 1);
+        out_str(l == depth - 1 ? (last ? sym->last_2 : sym->branch_2)
+                               : more[l + 1] ? sym->vert_2 : sym->empty_2);
+      }
+    }
+    size_t start = out.len;
+    if (rep > 1) {
+      char num[16];
+      int k = snprintf(num, sizeof(num), "%d*[", rep);
+      out_bytes(num, k);
+    }
+    // threads in braces, as psmisc does
+    int thread = pt.flags[n] & F_THREAD;
+    if (thread) out_bytes("{", 1);
+    out_str(NAME(n));
+    if (thread) out_bytes("}", 1);
+    if (pflag) {
+      char num[16];
+      int k = snprintf(num, sizeof(num), "(%d)", pt.pid[n]);
+      out_bytes(num, k);
+    }
+    if (rflag && !thread) out_usage(n);
+    width[depth] = out_cols(out.buf + start, out.len - start);
+    more[depth] = !last;
+
+    if (pt.son[n] != -1) {
+      stk[depth].node = n;
+      stk[depth].next = pt.son[n];
+      stk[depth].closing = closing;
+      depth++;
+    } else {
+      for (; closing > 0; --closing) out_bytes("]", 1);
+      // climb to the closest frame with a son left
+      while (depth > 0 && stk[depth - 1].next == -1) depth--;
+      if (depth == 0) break;
+    }
+
+    // the next son of the top frame, with the identical ones after it
+    struct frame *f = &stk[depth - 1];
+    n = f->next;
+    leaf = n == pt.son[f->node];
+    rep = 1;
+    int m = pt.brother[n];
+    if (!pflag && !cflag && !rflag) {
+      for (; m != -1 && tree_equal(n, m); m = pt.brother[m]) rep++;
+    }
+    f->next = m;
+    last = m == -1;
+    closing = (last ? f->closing : 0) + (rep > 1);
+    if (leaf) out_str(last ? sym->single_3 : sym->first_3);
+  }
+  out_bytes("\n", 1);
+}
+
+void print(int n) {
+  if (n != -1) render(n);
+  out_flush();
+}
+
+// --dump and --load: the header, then own[n], start[n], pid[n], ppid[n],
+// name[n], flags[n] as they are in the table, then names with each one stored
+// once; everything is in the byte order of the host that wrote it, and
+// each array is aligned for its type where the header leaves it
+#define SNAP_MAGIC   "pstree\0s"
+#define SNAP_VERSION 1
+
+struct snap_header {
+  char     magic[8];
+  uint32_t version;
+  uint32_t n;
+  uint64_t names_len;
+  int64_t  time;      // when it was taken, seconds since the epoch
+  char     host[64];
+};
+
+static size_t snap_size(uint64_t n, uint64_t names_len) {
+  return sizeof(struct snap_header) + n * (sizeof(struct usage) +
+         sizeof(uint64_t) + 2 * sizeof(pid_t) + sizeof(uint32_t) +
+         sizeof(uint8_t)) + names_len;
+}
+
+static uint32_t name_hash(const char *s) {
+  uint32_t h = 2166136261u;
+  for (; *s; ++s) h = (h ^ (unsigned char)*s) * 16777619u;
+  return h;
+}
 
-  int ret = chdir("/proc");
+// the table to file; the snapshot is laid out in out, then written at once
+static int dump(const char *file) {
+  // intern: off[i] is where the first entry of the same name put it
+  unsigned size = 16;
+  while (size < 2u * pt.n) size *= 2;
+  int *tab = malloc(size * sizeof(int));
+  uint32_t *off = malloc((pt.n + 1) * sizeof(uint32_t));
+  assert(tab && off);
+  memset(tab, -1, size * sizeof(int));
+  uint64_t len = 0;
+  for (int i = 0; i < pt.n; ++i) {
+    for (uint32_t h = name_hash(NAME(i)); ; ++h) {
+      int *slot = &tab[h & (size - 1)];
+      if (*slot == -1) {
+        *slot = i;
+        off[i] = len;
+        len += strlen(NAME(i)) + 1;
+        break;
+      }
+      if (strcmp(NAME(*slot), NAME(i)) == 0) {
+        off[i] = off[*slot];
+        break;
+      }
+    }
+  }
+  free(tab);
+
+  struct snap_header h = {
+    .magic = SNAP_MAGIC, .version = SNAP_VERSION, .n = pt.n,
+    .names_len = len, .time = time(NULL),
+  };
+  gethostname(h.host, sizeof(h.host) - 1);
+  out.len = 0;
+  out_bytes((char *)&h, sizeof(h));
+  out_bytes((char *)pt.own, pt.n * sizeof(struct usage));
+  out_bytes((char *)pt.start, pt.n * sizeof(uint64_t));
+  out_bytes((char *)pt.pid, pt.n * sizeof(pid_t));
+  out_bytes((char *)pt.ppid, pt.n * sizeof(pid_t));
+  out_bytes((char *)off, pt.n * sizeof(uint32_t));
+  out_bytes((char *)pt.flags, pt.n);
+  // the first of each name, whose offsets go up with i
+  uint32_t next = 0;
+  for (int i = 0; i < pt.n; ++i) {
+    if (off[i] != next) continue;
+    size_t k = strlen(NAME(i)) + 1;
+    out_bytes(NAME(i), k);
+    next += k;
+  }
+  free(off);
+  assert(out.len == snap_size(pt.n, len));
+
+  int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0 || out_write(fd) < 0 || close(fd) < 0) {
+    fprintf(stderr, "pstree: %s: %s\n", file, strerror(errno));
+    out.len = 0;
+    return -1;
+  }
+  return 0;
+}
+
+// file into t, its arrays left where they are in the mapping; only the
+// ones build() writes to are allocated
+static int load(const char *file, struct table *t) {
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "pstree: %s: %s\n", file, strerror(errno));
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  char *map = NULL;
+  if (st.st_size >= (off_t)sizeof(struct snap_header)) {
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) map = NULL;
+  }
+  close(fd);
+  const struct snap_header *h = (const struct snap_header *)map;
+  if (!h || memcmp(h->magic, SNAP_MAGIC, sizeof(h->magic)) ||
+      h->version != SNAP_VERSION || !h->n || h->n > INT32_MAX / 2 ||
+      h->names_len > UINT32_MAX ||
+      (size_t)st.st_size != snap_size(h->n, h->names_len) ||
+      !h->names_len || map[st.st_size - 1] != '\0') {
+    fprintf(stderr, "pstree: %s: not a snapshot\n", file);
+    if (map) munmap(map, st.st_size);
+    return -1;
+  }
+
+  memset(t, 0, sizeof(*t));
+  t->map = map;
+  t->map_len = st.st_size;
+  t->n = t->cap = h->n;
+  char *p = map + sizeof(*h);
+  t->own = (struct usage *)p;   p += t->n * sizeof(struct usage);
+  t->start = (uint64_t *)p;     p += t->n * sizeof(uint64_t);
+  t->pid = (pid_t *)p;          p += t->n * sizeof(pid_t);
+  t->ppid = (pid_t *)p;         p += t->n * sizeof(pid_t);
+  t->name = (uint32_t *)p;      p += t->n * sizeof(uint32_t);
+  t->flags = (uint8_t *)p;      p += t->n;
+  t->names.buf = p;
+  t->names.len = t->names.cap = h->names_len;
+  // one root, as link_sons() takes the last: every entry the walks from
+  // it reach then has its chain of parents end there, so no ppid cycle
+  // in the file can make them come round again
+  int roots = 0;
+  for (int i = 0; i < t->n; ++i) {
+    if (t->name[i] >= h->names_len) roots = -1;
+    if (roots >= 0 && t->ppid[i] == 0 && !(t->flags[i] & F_HIDDEN)) roots++;
+  }
+  if (roots != 1) {
+    fprintf(stderr, "pstree: %s: not a snapshot\n", file);
+    munmap(map, st.st_size);
+    return -1;
+  }
+  t->son = malloc((t->n + 1) * sizeof(int));
+  t->brother = malloc((t->n + 1) * sizeof(int));
+  t->last_son = malloc((t->n + 1) * sizeof(int));
+  t->mark = calloc(t->n + 1, 1);
+  t->sub = malloc((t->n + 1) * sizeof(struct usage));
+  assert(t->son && t->brother && t->last_son && t->mark && t->sub);
+  return 0;
+}
+
+static void unload(struct table *t) {
+  munmap(t->map, t->map_len);
+  free(t->son);
+  free(t->brother);
+  free(t->last_son);
+  free(t->mark);
+  free(t->sub);
+  memset(t, 0, sizeof(*t));
+}
+
+static void bench(int n) {
+  char tmp[] = "/tmp/pstree-bench-XXXXXX";
+  const char *dir = "/proc";
+  if (n > 0) {
+    dir = mkdtemp(tmp);
+    assert(dir);
+    fake_proc(dir, n);
+  }
+
+  scan(dir); // warm the dentry cache
+  if (n > 0) {
+    // every fake process must come back, names intact
+    assert(pt.n == n);
+    for (int i = 0; i < pt.n; ++i) {
+      char name[64];
+      fake_name(name, sizeof(name), pt.pid[i]);
+      assert(strcmp(NAME(i), name) == 0);
+    }
+  }
+  int rounds = 0;
+  double start = now_sec(), t;
+  do {
+    scan(dir);
+    rounds++;
+  } while ((t = now_sec() - start) < 1.0 || rounds < 3);
+  printf("%s: %d processes, %d threads, %.3f ms per scan, "
+         "%.0f ns per process\n", n > 0 ? "fake" : dir, pt.n, jflag,
+         t / rounds * 1e3, t / rounds / pt.n * 1e9);
+
+  rounds = 0;
+  start = now_sec();
+  do {
+    build();
+    rounds++;
+  } while ((t = now_sec() - start) < 0.5 || rounds < 3);
+  printf("%s: %.3f ms per tree build\n", n > 0 ? "fake" : dir,
+         t / rounds * 1e3);
+
+  rounds = 0;
+  start = now_sec();
+  size_t len;
+  do {
+    render(root);
+    len = out.len;
+    out.len = 0;
+    rounds++;
+  } while ((t = now_sec() - start) < 0.5 || rounds < 3);
+  printf("%s: %.3f ms per render, %zu bytes\n", n > 0 ? "fake" : dir,
+         t / rounds * 1e3, len);
+
+  // a snapshot of it, which must load back the same
+  char snap[] = "/tmp/pstree-snap-XXXXXX";
+  int fd = mkstemp(snap);
+  assert(fd >= 0);
+  close(fd);
+  start = now_sec();
+  int ret = dump(snap);
   assert(ret == 0);
+  t = now_sec() - start;
+  struct table copy;
+  ret = load(snap, &copy);
+  assert(ret == 0 && copy.n == pt.n);
+  for (int i = 0; i < pt.n; ++i) {
+    assert(copy.pid[i] == pt.pid[i] && copy.ppid[i] == pt.ppid[i] &&
+           copy.start[i] == pt.start[i]);
+    assert(strcmp(copy.names.buf + copy.name[i], NAME(i)) == 0);
+  }
+  printf("%s: %.3f ms per dump, %zu bytes\n", n > 0 ? "fake" : dir,
+         t * 1e3, copy.map_len);
+  unload(&copy);
 
-  DIR *dp = opendir(".");
-  assert(dp);
+  rounds = 0;
+  start = now_sec();
+  do {
+    ret = load(snap, &copy);
+    assert(ret == 0);
+    unload(&copy);
+    rounds++;
+  } while ((t = now_sec() - start) < 0.5 || rounds < 3);
+  printf("%s: %.3f ms per load\n", n > 0 ? "fake" : dir, t / rounds * 1e3);
+  unlink(snap);
 
-  struct dirent *dirname;
-  int pnum = 0;
-  while ( (dirname = readdir(dp)) ) {
-    // check whether it is a proc dir
-    if (!isnumber(dirname->d_name)) continue;
+  if (n > 0) fake_proc_remove(dir, n);
+}
 
-    char pathname[512];
-    strcpy(pathname, dirname->d_name);
-    strcat(pathname, "/status");
+// --watch: the table stays resident, and each round reads only the pids
+// that came, went, were reparented or may have been reused, then prints
+// those subtrees
+enum mark {
+  M_NONE = 0,
+  M_DEAD,    // gone, still linked in the old tree
+  M_CHANGED, // to be read again
+  M_BORN,    // read this round
+};
 
-    FILE *fp = fopen(pathname, "r");
-    assert(fp);
+static pid_t *born;
+static int nborn, born_cap;
 
-    char buf[512], name[256];
-    pid_t pid, ppid;
-    fscanf(fp, "Name:\t%s", name); // name may be not one word
-    while (fscanf(fp, "Pid:\t%d", &pid) != 1) fgets(buf, sizeof(buf), fp);
-    while (fscanf(fp, "PPid:\t%d", &ppid) != 1) fgets(buf, sizeof(buf), fp);
+static void add_born(pid_t pid) {
+  if (nborn == born_cap) {
+    born_cap = born_cap ? born_cap * 2 : 64;
+    born = realloc(born, born_cap * sizeof(pid_t));
+    assert(born);
+  }
+  born[nborn++] = pid;
+}
 
-    // filter
-    if (pid == 2 || ppid == 2) continue;
+static int parent_of(int i) {
+  return pt.ppid[i] ? *pid_slot(pt.ppid[i]) : -1;
+}
 
-    strcpy(plist[pnum].name, name);
-    plist[pnum].pid = pid;
-    plist[pnum].ppid = ppid;
-    plist[pnum].brother = -1;
-    plist[pnum].son = -1;
-    pnum++;
+// i and its sons marked the same, the top one with its parent
+static void print_diff(char sign, int i, int depth) {
+  for (int d = 0; d < depth; ++d) printf("\t");
+  printf("%c %s(%d)", sign, NAME(i), pt.pid[i]);
+  int j = parent_of(i);
+  if (!depth && j != -1) printf(" under %s(%d)", NAME(j), pt.pid[j]);
+  printf("\n");
+  for (int c = pt.son[i]; c != -1; c = pt.brother[c]) {
+    if (pt.mark[c] == pt.mark[i]) print_diff(sign, c, depth + 1);
+  }
+}
 
-    fclose(fp);
+// the topmost subtrees marked mark
+static void print_marked(char sign, enum mark mark) {
+  for (int i = 0; i < pt.n; ++i) {
+    int j = parent_of(i);
+    if (pt.mark[i] == mark && !(pt.flags[i] & F_HIDDEN) &&
+        (j == -1 || pt.mark[j] != mark)) {
+      print_diff(sign, i, 0);
+    }
   }
-  closedir(dp);
+}
+
+// where the kernel hands out the next pid: it goes round from the last
+// one, so a pid can only have been reused if the cursor passed it; the
+// fork count tells whether it may have gone all the way round
+struct cursor {
+  pid_t last;      // -1 if unknown
+  int threads;
+  uint64_t forks;
+};
+static struct cursor cursor;
+static int pid_max;
+
+// path under dfd into buf, grown to fit; its length, or -1
+static ssize_t read_file(int dfd, const char *path, char **buf, size_t *cap) {
+  int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  ssize_t len = 0, n;
+  do {
+    if ((size_t)len + 1 >= *cap) {
+      *cap = *cap ? *cap * 2 : 4096;
+      *buf = realloc(*buf, *cap);
+      assert(*buf);
+    }
+    n = read(fd, *buf + len, *cap - len - 1);
+    if (n > 0) len += n;
+  } while (n > 0);
+  close(fd);
+  if (n < 0) return -1;
+  (*buf)[len] = '\0';
+  return len;
+}
 
-  if (nflag) {
-    // numeric sort
+// loadavg ends "running/threads last_pid", stat has "processes forks"
+static void read_cursor(int dfd, struct cursor *c) {
+  static char *buf;
+  static size_t cap;
+  c->last = -1;
+  if (read_file(dfd, "stat", &buf, &cap) < 0) return;
+  const char *f = strstr(buf, "\nprocesses ");
+  if (!f) return;
+  parse_u64(f + sizeof("\nprocesses ") - 1, &c->forks);
+  if (read_file(dfd, "loadavg", &buf, &cap) < 0) return;
+  f = strchr(skip_fields(buf, 3), '/');
+  if (!f) return;
+  f = parse_int(f + 1, &c->threads);
+  parse_int(f + 1, &c->last);
+}
+
+// polling: tell the pids that came and went apart by the listing, and
+// a pid that went and came back by its starttime; that costs reading
+// /proc, stat and loadavg each round, plus one <pid>/stat for each pid
+// in the table the cursor passed, or for all of them after a lap
+static void watch_poll(DIR *dp) {
+  // read before the listing, so that pids handed out after it are in the
+  // next round's range; a lap takes at least as many forks as there are
+  // free pids, and the count is system-wide, so it errs towards reading
+  struct cursor then = cursor;
+  read_cursor(dirfd(dp), &cursor);
+  long nfree = (long)pid_max - cursor.threads;
+  int all = then.last < 0 || cursor.last < 0 ||
+            cursor.forks - then.forks >= (uint64_t)(nfree > 0 ? nfree : 0);
+  list_pids(dp);
+  for (int i = 0; i < pt.n; ++i) pt.mark[i] = M_DEAD;
+  for (int k = 0; k < job.npid; ++k) {
+    struct proc p;
+    pid_t pid = job.pids[k];
+    int i = *pid_slot(pid);
+    int passed = then.last <= cursor.last
+                 ? then.last < pid && pid <= cursor.last
+                 : then.last < pid || pid <= cursor.last;
+    if (i == -1) {
+      add_born(pid);
+    } else if ((all || passed) && read_stat(dirfd(dp), pid, &p) == 0 &&
+               p.start != pt.start[i]) {
+      add_born(pid); // reused; the old one stays M_DEAD
+    } else {
+      pt.mark[i] = M_NONE; // or gone since the listing, next round
+    }
   }
-  else {
-    // name sort
+}
+
+// whether the connector took our PROC_CN_MCAST_LISTEN; outside the
+// initial namespaces the kernel ignores it, with neither ack nor events,
+// so no answer soon means no
+static int cn_acked(int fd) {
+  double until = now_sec() + 0.2;
+  for (;;) {
+    int left = (until - now_sec()) * 1e3;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (left <= 0 || poll(&pfd, 1, left) <= 0) return 0;
+
+    char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) return 0;
+    // events that beat the ack come before the first scan, and can go
+    for (struct nlmsghdr *nl = (struct nlmsghdr *)buf; NLMSG_OK(nl, n);
+         nl = NLMSG_NEXT(nl, n)) {
+      struct proc_event *ev =
+        (struct proc_event *)((struct cn_msg *)NLMSG_DATA(nl))->data;
+      if (ev->what == PROC_EVENT_NONE) return !ev->event_data.ack.err;
+    }
   }
+}
 
+// the proc connector reports forks, execs and exits as they happen, but
+// only to CAP_NET_ADMIN in the initial namespaces; -1 if we cannot have it
+static int cn_open() {
+  int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+  if (fd < 0) return -1;
+  struct sockaddr_nl sa = {
+    .nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC, .nl_pid = getpid(),
+  };
+  struct __attribute__((packed)) {
+    struct nlmsghdr nl;
+    struct cn_msg cn;
+    enum proc_cn_mcast_op op;
+  } msg = {
+    .nl = { .nlmsg_len = sizeof(msg), .nlmsg_type = NLMSG_DONE,
+            .nlmsg_pid = getpid() },
+    .cn = { .id = { CN_IDX_PROC, CN_VAL_PROC },
+            .len = sizeof(enum proc_cn_mcast_op) },
+    .op = PROC_CN_MCAST_LISTEN,
+  };
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+      send(fd, &msg, sizeof(msg), 0) != sizeof(msg) || !cn_acked(fd)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
 
-  // build the tree
+// collect connector events for up to ms; -1 if it failed us and we
+// must poll instead
+static int watch_events(int fd, int ms) {
+  double until = now_sec() + ms / 1e3;
+  for (;;) {
+    int left = (until - now_sec()) * 1e3;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (left <= 0 || poll(&pfd, 1, left) <= 0) return 0;
 
-  // .brother = the other proc whose ppid is the same
-  // .son = the first proc whose ppid equals its pid
-  for (int i = 0; i < pnum; ++i) {
+    char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) return -1; // ENOBUFS: we lost events
+    for (struct nlmsghdr *nl = (struct nlmsghdr *)buf; NLMSG_OK(nl, n);
+         nl = NLMSG_NEXT(nl, n)) {
+      struct proc_event *ev =
+        (struct proc_event *)((struct cn_msg *)NLMSG_DATA(nl))->data;
+      int i;
+      switch (ev->what) {
+        case PROC_EVENT_NONE:
+          if (ev->event_data.ack.err) return -1; // not allowed after all
+          break;
+        case PROC_EVENT_FORK:
+          // threads are forks too
+          if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid) {
+            add_born(ev->event_data.fork.child_tgid);
+          }
+          break;
+        case PROC_EVENT_EXEC:
+        case PROC_EVENT_COMM:
+          i = *pid_slot(ev->event_data.exec.process_tgid);
+          if (i != -1 && pt.mark[i] == M_NONE) pt.mark[i] = M_CHANGED;
+          break;
+        case PROC_EVENT_EXIT:
+          if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid) {
+            break;
+          }
+          i = *pid_slot(ev->event_data.exit.process_tgid);
+          if (i != -1) pt.mark[i] = M_DEAD;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
 
-    // root of pstree
-    assert(plist[i].ppid != 2);
-    if (plist[i].ppid == 0) {
-      root = i;
+static int cmp_pid_t(const void *a, const void *b) {
+  pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+  return (x > y) - (x < y);
+}
+
+// act on the marks and born[], print what changed
+static void watch_apply(int dfd) {
+  // drop born pids that raced with the first scan or came twice; one
+  // whose entry is M_DEAD was reused, and the entry goes below
+  qsort(born, nborn, sizeof(pid_t), cmp_pid_t);
+  int n = 0;
+  for (int k = 0; k < nborn; ++k) {
+    int i = *pid_slot(born[k]);
+    if ((n && born[n - 1] == born[k]) || (i != -1 && pt.mark[i] != M_DEAD)) {
       continue;
     }
+    born[n++] = born[k];
+  }
+  nborn = n;
 
-    // transverse the plist to find every one's brother and son
-    for (int j = 0; j < pnum; ++j) {
+  // the orphans were reparented
+  for (int i = 0; i < pt.n; ++i) {
+    if (pt.mark[i] != M_DEAD) continue;
+    for (int c = pt.son[i]; c != -1; c = pt.brother[c]) {
+      if (pt.mark[c] == M_NONE) pt.mark[c] = M_CHANGED;
+    }
+  }
+  print_marked('-', M_DEAD);
+
+  n = 0;
+  for (int i = 0; i < pt.n; ++i) {
+    struct proc p;
+    if (pt.mark[i] == M_CHANGED && read_stat(dfd, pt.pid[i], &p) == 0) {
+      pt.names.dead += strlen(NAME(i)) + 1;
+      pt.name[i] = names_add(p.name);
+      pt.ppid[i] = p.ppid;
+      pt.flags[i] = p.flags;
+      pt.start[i] = p.start;
+      pt.own[i] = p.own;
+      pt.mark[i] = M_NONE;
+    }
+    if (pt.mark[i] != M_NONE) { // dead, or gone before we could read it
+      pt.names.dead += strlen(NAME(i)) + 1;
+      continue;
+    }
+    pt.pid[n] = pt.pid[i];
+    pt.ppid[n] = pt.ppid[i];
+    pt.name[n] = pt.name[i];
+    pt.flags[n] = pt.flags[i];
+    pt.start[n] = pt.start[i];
+    pt.own[n] = pt.own[i];
+    pt.mark[n++] = M_NONE;
+  }
+  pt.n = n;
+  for (int k = 0; k < nborn; ++k) {
+    struct proc p;
+    if (read_stat(dfd, born[k], &p) < 0) continue; // gone already
+    pt.mark[pt_add(&p)] = M_BORN;
+  }
+  nborn = 0;
+  names_compact();
+  build();
 
-      // check whether plist[j] relates to plist[i]
-      if (plist[i].ppid == plist[j].pid) {
+  print_marked('+', M_BORN);
+  for (int i = 0; i < pt.n; ++i) pt.mark[i] = M_NONE;
+  fflush(stdout);
+}
 
-        if (plist[j].son == -1) {
-          // the first son of plist[j]
-          plist[j].son = i;
+static void watch(double interval) {
+  DIR *dp = opendir("/proc");
+  assert(dp);
+  int ms = interval * 1e3, cn = cn_open();
+  char *buf = NULL;
+  size_t cap = 0;
+  if (read_file(dirfd(dp), "sys/kernel/pid_max", &buf, &cap) > 0) {
+    parse_int(buf, &pid_max);
+  }
+  free(buf);
+  read_cursor(dirfd(dp), &cursor);
+  scan("/proc");
+  build();
+  print(root);
+  fflush(stdout);
+  for (;;) {
+    if (cn >= 0 && watch_events(cn, ms) < 0) {
+      close(cn);
+      cn = -1;
+      nborn = 0;
+    }
+    if (cn < 0) {
+      usleep(ms * 1000);
+      watch_poll(dp);
+    }
+    watch_apply(dirfd(dp));
+  }
+}
+
+// --diff=OLD: what exited since old was taken, then what was forked; a
+// pid is the same process in both if it has the same starttime, so a
+// worker restarted under its old pid and name counts as both
+static void diff(struct table *old) {
+  struct table now = pt;
+  build();
+  for (int i = 0; i < old->n; ++i) {
+    int j = *pid_slot(old->pid[i]);
+    old->mark[i] = j != -1 && pt.start[j] == old->start[i] ? M_NONE : M_DEAD;
+  }
+  pt = *old;
+  build();
+  for (int i = 0; i < now.n; ++i) {
+    int j = *pid_slot(now.pid[i]);
+    now.mark[i] = j != -1 && pt.start[j] == now.start[i] ? M_NONE : M_BORN;
+  }
+  print_marked('-', M_DEAD);
+  pt = now;
+  build();
+  print_marked('+', M_BORN);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+
+  // line drawing in UTF-8 if the locale is
+  setlocale(LC_CTYPE, "");
+  if (strcmp(nl_langinfo(CODESET), "UTF-8") == 0) sym = &sym_utf8;
+
+  // getopt
+  while ((c = getopt_long(argc, argv, "AcUnprtj:V", long_options, 0)) != -1) {
+    switch (c) {
+      case 'A': sym = &sym_ascii; break;
+      case 'U': sym = &sym_utf8; break;
+      case 'c': cflag = 1; break;
+      case 'n': skey = SORT_PID; break;
+      case 'r': rflag = 1; break;
+      case 't': tflag = 1; break;
+      case 'S':
+        for (skey = 0; skey < sizeof(sort_keys) / sizeof(sort_keys[0]); ++skey) {
+          if (strcmp(optarg, sort_keys[skey]) == 0) break;
         }
-        else {
-          // the other son of plist[j]
-          int cur = plist[j].son;
-          while (plist[cur].brother != -1) cur = plist[cur].brother;
-          plist[cur].brother = i;
-        } 
-      }
+        if (skey == sizeof(sort_keys) / sizeof(sort_keys[0])) {
+          fprintf(stderr, "%s", Usage);
+          return 1;
+        }
+        break;
+      case 'p': pflag = 1; break;
+      case 'j': jflag = atoi(optarg); break;
+      case 'V': fprintf(stderr, "%s", version); return 0;
+      case 'W': wflag = atof(optarg); break;
+      case 'B': bflag = optarg ? atoi(optarg) : 0; break;
+      case 'D': dflag = optarg; break;
+      case 'L': lflag = optarg; break;
+      case 'O': oflag = optarg; break;
+      case '?': fprintf(stderr, "%s", Usage); return 0;
+      default:  return 1;
     }
   }
 
+  if (optind < argc) {
+    printf("non-option ARGV-elements: ");
+    while (optind < argc)
+      printf("%s ", argv[optind++]);
+    printf("\n");
+  }
+
+  if (jflag <= 0) jflag = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (bflag >= 0) {
+    bench(bflag);
+    return 0;
+  }
+
+  if (wflag > 0) {
+    tflag = 0; // the listing would not show threads come and go
+    watch(wflag);
+    return 0;
+  }
+
+  if (lflag) {
+    if (load(lflag, &pt) < 0) return 1;
+  } else {
+    scan("/proc");
+  }
+
+  if (dflag) return dump(dflag) < 0;
+
+  if (oflag) {
+    struct table old;
+    if (load(oflag, &old) < 0) return 1;
+    diff(&old);
+    return 0;
+  }
+
+  build();
+
   // print the tree
   print(root);
 
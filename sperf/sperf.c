@@ -4,46 +4,104 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
-#include <regex.h>
 #include <time.h>
 #include <dirent.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <linux/audit.h>
+#include "syscalls.h"
 
 // #define __DEBUG__
 
 extern char **environ;
 
+#define NSYSCALL (sizeof(syscall_names) / sizeof(syscall_names[0]))
+#define NEXTRA   64 // names not in syscall_names, as strace may print
+
+// indexed like syscall_names, then by the extra names in the order they
+// came; nothing is allocated once the first syscall is in
 struct info {
-  char name[32];
-  double time;
-} syscall_info[1000];
+  const char *name;
+  long count;
+  double total, min, max;
+} syscall_info[NSYSCALL + NEXTRA];
 
-int compare(const void *a, const void *b) {
-  return ((struct info *)a)->time < ((struct info *)b)->time;
+char extra_names[NEXTRA][32];
+int nextra = 0;
+double total_time = 0;
+
+// from name to index into syscall_info: open addressing, each slot holds
+// the index plus one, at most half full
+#define NAME_TAB 2048
+short name_tab[NAME_TAB];
+
+unsigned name_hash(const char *name, size_t len) {
+  unsigned h = 2166136261u;
+  for (size_t i = 0; i < len; ++i) h = (h ^ (unsigned char)name[i]) * 16777619u;
+  return h;
 }
 
-int syscall_num = 0;
-double total_time = 0;
+short *name_slot(const char *name, size_t len) {
+  for (unsigned h = name_hash(name, len); ; ++h) {
+    short *slot = &name_tab[h & (NAME_TAB - 1)];
+    if (*slot == 0) return slot;
+    const char *s = syscall_info[*slot - 1].name;
+    if (strncmp(s, name, len) == 0 && s[len] == '\0') return slot;
+  }
+}
 
-void add_info(char *name, double time) {
-  total_time += time;
-  for (int i = 0; i < syscall_num; ++i) {
-    if (strcmp(name, syscall_info[i].name) == 0) {
-      syscall_info[i].time += time;
-      return;
-    }
+void init_info() {
+  _Static_assert(2 * (NSYSCALL + NEXTRA) <= NAME_TAB, "name_tab too small");
+  for (int i = 0; i < NSYSCALL; ++i) {
+    syscall_info[i].name = syscall_names[i];
+    *name_slot(syscall_names[i], strlen(syscall_names[i])) = i + 1;
   }
-  strcpy(syscall_info[syscall_num].name, name);
-  syscall_info[syscall_num].time = time;
-  syscall_num++;
-  return;
+}
+
+// the index of the syscall called name, which is len bytes and need not
+// end in a NUL; -1 if there are too many unknown ones to tell apart.
+// Names are cut to what extra_names holds before they are looked up, so
+// that a long one finds its slot again.
+int syscall_id(const char *name, size_t len) {
+  if (len >= sizeof(extra_names[0])) len = sizeof(extra_names[0]) - 1;
+  short *slot = name_slot(name, len);
+  if (*slot) return *slot - 1;
+  if (nextra == NEXTRA) return -1;
+  memcpy(extra_names[nextra], name, len);
+  extra_names[nextra][len] = '\0';
+  int id = NSYSCALL + nextra++;
+  syscall_info[id].name = extra_names[id - NSYSCALL];
+  *slot = id + 1;
+  return id;
+}
+
+// id -1, a name that got no slot, still counts in the total
+void add_info(int id, double time) {
+  total_time += time;
+  if (id == -1) return;
+  struct info *p = &syscall_info[id];
+  if (p->count++ == 0 || time < p->min) p->min = time;
+  if (time > p->max) p->max = time;
+  p->total += time;
+}
+
+int compare(const void *a, const void *b) {
+  double x = (*(struct info **)a)->total, y = (*(struct info **)b)->total;
+  return (x < y) - (x > y);
 }
 
 void print_info() {
-  qsort(syscall_info, syscall_num, sizeof(struct info), compare);
+  static struct info *top[NSYSCALL + NEXTRA];
+  int n = 0;
+  for (int i = 0; i < NSYSCALL + nextra; ++i) {
+    if (syscall_info[i].count) top[n++] = &syscall_info[i];
+  }
+  qsort(top, n, sizeof(struct info *), compare);
   printf("total time: %f\n", total_time);
-  for (int i = 0; i < syscall_num && i < 5; ++i) {
-    int percent = syscall_info[i].time / total_time * 100;
-    printf("%s (%d%%)\n", syscall_info[i].name, percent);
+  for (int i = 0; i < n && i < 5; ++i) {
+    int percent = top[i]->total / total_time * 100;
+    printf("%s (%d%%)\n", top[i]->name, percent);
   }
   for (int i = 0; i < 80; ++i) {
     putc('\0', stdout);
@@ -51,14 +109,192 @@ void print_info() {
   fflush(stdout);
 }
 
-int main(int argc, char *argv[]) {
+// time spent in syscall nr of the ABI arch, named as strace would
+void add_syscall(unsigned arch, long nr, double time) {
+  const short *tab = NULL;
+  long n = 0;
+  if (arch == AUDIT_ARCH_X86_64) {
+    tab = syscall_x86_64;
+    n = sizeof(syscall_x86_64) / sizeof(syscall_x86_64[0]);
+  } else if (arch == AUDIT_ARCH_I386) {
+    tab = syscall_i386;
+    n = sizeof(syscall_i386) / sizeof(syscall_i386[0]);
+  }
+  if (nr >= 0 && nr < n && tab[nr]) {
+    add_info(tab[nr] - 1, time);
+  } else {
+    char name[32];
+    add_info(syscall_id(name, snprintf(name, sizeof(name), "syscall_%ld", nr)),
+             time);
+  }
+}
 
-#ifdef __DEBUG__
-  printf("argc: %d\n", argc);
-  for (int i = 0; i < argc; ++i) {
-    printf("argv[%d]: %s\n", i, argv[i]);
+double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Trace argv ourselves: the child stops at each syscall entry and exit,
+// and the time between the two is what strace -T would print
+int run_ptrace(char *argv[]) {
+  pid_t pid = fork();
+  if (pid == -1) {
+    perror("fork");
+    exit(EXIT_FAILURE);
   }
-#endif
+  if (pid == 0) {
+    // Child process
+    int fd = open("/dev/null", O_WRONLY);
+    dup2(fd, STDOUT_FILENO);
+    if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1) {
+      perror("ptrace");
+      exit(EXIT_FAILURE);
+    }
+    raise(SIGSTOP); // wait for the options to be set
+    execvp(argv[0], argv);
+    perror("execvp");
+    exit(EXIT_FAILURE);
+  }
+
+  // Parent process
+  int status;
+  if (waitpid(pid, &status, 0) == -1 || !WIFSTOPPED(status)) {
+    return EXIT_FAILURE;
+  }
+  // syscall stops come with SIGTRAP | 0x80, and execve() with an event
+  // instead of a SIGTRAP of its own
+  ptrace(PTRACE_SETOPTIONS, pid, NULL,
+         PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL);
+
+  time_t old, new;
+  old = time(NULL);
+  long nr = -1;
+  unsigned arch = 0; // a 64-bit process may make i386 syscalls too
+  double entered = 0;
+  int sig = 0;
+  for (;;) {
+    ptrace(PTRACE_SYSCALL, pid, NULL, sig);
+    sig = 0;
+    if (waitpid(pid, &status, 0) == -1 || !WIFSTOPPED(status)) break;
+    double t = now();
+    if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+      struct __ptrace_syscall_info info;
+      if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) <= 0) {
+        // Linux 5.3 and later only
+        perror("ptrace(PTRACE_GET_SYSCALL_INFO)");
+        exit(EXIT_FAILURE); // PTRACE_O_EXITKILL takes the child along
+      }
+      if (info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+        nr = info.entry.nr;
+        arch = info.arch;
+        entered = t;
+      } else if (info.op == PTRACE_SYSCALL_INFO_EXIT && nr != -1) {
+        add_syscall(arch, nr, t - entered);
+        nr = -1;
+      }
+    } else if (status >> 16 == 0) {
+      // a signal for the child, not one of our events: pass it on
+      sig = WSTOPSIG(status);
+    }
+    new = time(NULL);
+    if (new - old >= 1) {
+      print_info();
+      old = new;
+    }
+  }
+  print_info();
+  return 0;
+}
+
+long lines = 0; // of strace output read
+
+// one line of strace -T output, without its '\n': "name(args) = ret <secs>"
+// counts if it starts with the name and ends with the time, which is
+// where strace puts them; nothing is copied
+void parse_line(const char *line, const char *end) {
+  const char *p = line;
+  while (p < end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                     (*p >= '0' && *p <= '9') || *p == '_')) p++;
+  if (p == line || p == end || *p != '(') return;
+
+  // back over "<secs>", then forward over it
+  const char *q = end;
+  if (q > p && q[-1] == '\r') q--;
+  if (q == p || *--q != '>') return;
+  const char *t = q;
+  while (t > p && ((t[-1] >= '0' && t[-1] <= '9') || t[-1] == '.')) t--;
+  if (t == p || t[-1] != '<' || t == q) return;
+  double secs = 0, scale = 1;
+  for (; t < q && *t != '.'; ++t) secs = secs * 10 + (*t - '0');
+  for (++t; t < q; ++t) secs += (*t - '0') * (scale /= 10);
+
+  add_info(syscall_id(line, p - line), secs);
+}
+
+// strace -T output from fd, up to its end, read in big chunks; a line
+// cut at the end of one is moved to the front for the next
+void read_trace(int fd) {
+  static char *buf;
+  static size_t cap = 1 << 20;
+  if (!buf) buf = malloc(cap);
+  if (!buf) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  size_t len = 0;
+  time_t old, new;
+  old = time(NULL);
+  for (;;) {
+    if (len == cap) {
+      // a line longer than the buffer
+      buf = realloc(buf, cap *= 2);
+      if (!buf) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+      }
+    }
+    ssize_t n = read(fd, buf + len, cap - len);
+    if (n <= 0) break;
+    len += n;
+    char *line = buf, *end = buf + len, *nl;
+    while ((nl = memchr(line, '\n', end - line))) {
+      parse_line(line, nl);
+      lines++;
+      line = nl + 1;
+    }
+    len = end - line;
+    memmove(buf, line, len);
+    new = time(NULL);
+    if (new - old >= 1) {
+      print_info();
+      old = new;
+    }
+  }
+  if (len) {
+    parse_line(buf, buf + len);
+    lines++;
+  }
+  print_info();
+}
+
+// A recorded strace -T log through the same parser, timed
+int run_replay(const char *file) {
+  int fd = open(file, O_RDONLY);
+  if (fd == -1) {
+    perror(file);
+    return EXIT_FAILURE;
+  }
+  double start = now();
+  read_trace(fd);
+  double t = now() - start;
+  close(fd);
+  fprintf(stderr, "%ld lines in %.3f s, %.0f lines/s\n", lines, t, lines / t);
+  return 0;
+}
+
+// The old way, through strace -T and its output
+int run_strace(int argc, char *argv[]) {
 
   // Get the arguments of strace 
   char **exec_argv = malloc(sizeof(char *) * (argc + 2));
@@ -79,14 +315,6 @@ int main(int argc, char *argv[]) {
 
   char *path = strdup(getenv("PATH"));
   
-  // regex
-  regex_t regex_name, regex_time;
-  if (regcomp(&regex_name, "^[a-zA-Z_0-9]*\\(", REG_EXTENDED) != 0 || regcomp(&regex_time, "<[0-9]*\\.[0-9]*>", REG_EXTENDED) != 0) {
-    // error handling
-    perror("regcomp");
-    exit(EXIT_FAILURE);
-  }
-
   // Create the pipe
   int fildes[2];
   if (pipe(fildes) == -1) {
@@ -121,31 +349,33 @@ int main(int argc, char *argv[]) {
   } else {
     // Parent process
     close(fildes[1]);
-    dup2(fildes[0], STDIN_FILENO);
-    char buf[1024];
-
-
-    regmatch_t matchname, matchtime;
-    time_t old, new;
-    old = time(NULL);
-    char syscall_name[32];
-    double syscall_time;
-    while (fgets(buf, 1024, stdin)) {
-      if (regexec(&regex_name, buf, 1, &matchname, 0) == 0 && regexec(&regex_time, buf, 1, &matchtime, 0) == 0) {
-        strncpy(syscall_name, buf + matchname.rm_so, matchname.rm_eo - matchname.rm_so);
-        syscall_name[matchname.rm_eo - matchname.rm_so - 1] = '\0';
-        syscall_time = atof(buf + matchtime.rm_so + 1);
-        add_info(syscall_name, syscall_time);
-      }
-      new = time(NULL);
-      if (new - old >= 1) {
-        print_info();
-        old = new;
-      }
-    }
-    print_info();
-    regfree(&regex_name);
-    regfree(&regex_time);
+    read_trace(fildes[0]);
+    close(fildes[0]);
   }
   return 0;
 }
+
+int main(int argc, char *argv[]) {
+
+#ifdef __DEBUG__
+  printf("argc: %d\n", argc);
+  for (int i = 0; i < argc; ++i) {
+    printf("argv[%d]: %s\n", i, argv[i]);
+  }
+#endif
+
+  init_info();
+  if (argc > 1 && strncmp(argv[1], "--replay=", 9) == 0) {
+    return run_replay(argv[1] + 9);
+  }
+  if (argc > 1 && strcmp(argv[1], "--strace") == 0) {
+    argv[1] = argv[0];
+    return run_strace(argc - 1, argv + 1);
+  }
+  if (argc < 2) {
+    fprintf(stderr, "Usage: sperf [--strace] COMMAND [ARG]...\n"
+                    "   or: sperf --replay=FILE\n");
+    return EXIT_FAILURE;
+  }
+  return run_ptrace(argv + 1);
+}
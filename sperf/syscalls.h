@@ -0,0 +1,1267 @@
+// Generated by syscalls.sh from the x86-64 and i386 <asm/unistd_*.h>.
+// The numbers depend on the tracee's ABI, not the one sperf is built for.
+
+// every syscall name of either ABI, sorted; sperf counts by index here
+static const char *syscall_names[] = {
+  "_llseek",
+  "_newselect",
+  "_sysctl",
+  "accept",
+  "accept4",
+  "access",
+  "acct",
+  "add_key",
+  "adjtimex",
+  "afs_syscall",
+  "alarm",
+  "arch_prctl",
+  "bdflush",
+  "bind",
+  "bpf",
+  "break",
+  "brk",
+  "capget",
+  "capset",
+  "chdir",
+  "chmod",
+  "chown",
+  "chown32",
+  "chroot",
+  "clock_adjtime",
+  "clock_adjtime64",
+  "clock_getres",
+  "clock_getres_time64",
+  "clock_gettime",
+  "clock_gettime64",
+  "clock_nanosleep",
+  "clock_nanosleep_time64",
+  "clock_settime",
+  "clock_settime64",
+  "clone",
+  "clone3",
+  "close",
+  "close_range",
+  "connect",
+  "copy_file_range",
+  "creat",
+  "create_module",
+  "delete_module",
+  "dup",
+  "dup2",
+  "dup3",
+  "epoll_create",
+  "epoll_create1",
+  "epoll_ctl",
+  "epoll_ctl_old",
+  "epoll_pwait",
+  "epoll_pwait2",
+  "epoll_wait",
+  "epoll_wait_old",
+  "eventfd",
+  "eventfd2",
+  "execve",
+  "execveat",
+  "exit",
+  "exit_group",
+  "faccessat",
+  "faccessat2",
+  "fadvise64",
+  "fadvise64_64",
+  "fallocate",
+  "fanotify_init",
+  "fanotify_mark",
+  "fchdir",
+  "fchmod",
+  "fchmodat",
+  "fchown",
+  "fchown32",
+  "fchownat",
+  "fcntl",
+  "fcntl64",
+  "fdatasync",
+  "fgetxattr",
+  "finit_module",
+  "flistxattr",
+  "flock",
+  "fork",
+  "fremovexattr",
+  "fsconfig",
+  "fsetxattr",
+  "fsmount",
+  "fsopen",
+  "fspick",
+  "fstat",
+  "fstat64",
+  "fstatat64",
+  "fstatfs",
+  "fstatfs64",
+  "fsync",
+  "ftime",
+  "ftruncate",
+  "ftruncate64",
+  "futex",
+  "futex_time64",
+  "futex_waitv",
+  "futimesat",
+  "get_kernel_syms",
+  "get_mempolicy",
+  "get_robust_list",
+  "get_thread_area",
+  "getcpu",
+  "getcwd",
+  "getdents",
+  "getdents64",
+  "getegid",
+  "getegid32",
+  "geteuid",
+  "geteuid32",
+  "getgid",
+  "getgid32",
+  "getgroups",
+  "getgroups32",
+  "getitimer",
+  "getpeername",
+  "getpgid",
+  "getpgrp",
+  "getpid",
+  "getpmsg",
+  "getppid",
+  "getpriority",
+  "getrandom",
+  "getresgid",
+  "getresgid32",
+  "getresuid",
+  "getresuid32",
+  "getrlimit",
+  "getrusage",
+  "getsid",
+  "getsockname",
+  "getsockopt",
+  "gettid",
+  "gettimeofday",
+  "getuid",
+  "getuid32",
+  "getxattr",
+  "gtty",
+  "idle",
+  "init_module",
+  "inotify_add_watch",
+  "inotify_init",
+  "inotify_init1",
+  "inotify_rm_watch",
+  "io_cancel",
+  "io_destroy",
+  "io_getevents",
+  "io_pgetevents",
+  "io_pgetevents_time64",
+  "io_setup",
+  "io_submit",
+  "io_uring_enter",
+  "io_uring_register",
+  "io_uring_setup",
+  "ioctl",
+  "ioperm",
+  "iopl",
+  "ioprio_get",
+  "ioprio_set",
+  "ipc",
+  "kcmp",
+  "kexec_file_load",
+  "kexec_load",
+  "keyctl",
+  "kill",
+  "landlock_add_rule",
+  "landlock_create_ruleset",
+  "landlock_restrict_self",
+  "lchown",
+  "lchown32",
+  "lgetxattr",
+  "link",
+  "linkat",
+  "listen",
+  "listxattr",
+  "llistxattr",
+  "lock",
+  "lookup_dcookie",
+  "lremovexattr",
+  "lseek",
+  "lsetxattr",
+  "lstat",
+  "lstat64",
+  "madvise",
+  "mbind",
+  "membarrier",
+  "memfd_create",
+  "memfd_secret",
+  "migrate_pages",
+  "mincore",
+  "mkdir",
+  "mkdirat",
+  "mknod",
+  "mknodat",
+  "mlock",
+  "mlock2",
+  "mlockall",
+  "mmap",
+  "mmap2",
+  "modify_ldt",
+  "mount",
+  "mount_setattr",
+  "move_mount",
+  "move_pages",
+  "mprotect",
+  "mpx",
+  "mq_getsetattr",
+  "mq_notify",
+  "mq_open",
+  "mq_timedreceive",
+  "mq_timedreceive_time64",
+  "mq_timedsend",
+  "mq_timedsend_time64",
+  "mq_unlink",
+  "mremap",
+  "msgctl",
+  "msgget",
+  "msgrcv",
+  "msgsnd",
+  "msync",
+  "munlock",
+  "munlockall",
+  "munmap",
+  "name_to_handle_at",
+  "nanosleep",
+  "newfstatat",
+  "nfsservctl",
+  "nice",
+  "oldfstat",
+  "oldlstat",
+  "oldolduname",
+  "oldstat",
+  "olduname",
+  "open",
+  "open_by_handle_at",
+  "open_tree",
+  "openat",
+  "openat2",
+  "pause",
+  "perf_event_open",
+  "personality",
+  "pidfd_getfd",
+  "pidfd_open",
+  "pidfd_send_signal",
+  "pipe",
+  "pipe2",
+  "pivot_root",
+  "pkey_alloc",
+  "pkey_free",
+  "pkey_mprotect",
+  "poll",
+  "ppoll",
+  "ppoll_time64",
+  "prctl",
+  "pread64",
+  "preadv",
+  "preadv2",
+  "prlimit64",
+  "process_madvise",
+  "process_mrelease",
+  "process_vm_readv",
+  "process_vm_writev",
+  "prof",
+  "profil",
+  "pselect6",
+  "pselect6_time64",
+  "ptrace",
+  "putpmsg",
+  "pwrite64",
+  "pwritev",
+  "pwritev2",
+  "query_module",
+  "quotactl",
+  "quotactl_fd",
+  "read",
+  "readahead",
+  "readdir",
+  "readlink",
+  "readlinkat",
+  "readv",
+  "reboot",
+  "recvfrom",
+  "recvmmsg",
+  "recvmmsg_time64",
+  "recvmsg",
+  "remap_file_pages",
+  "removexattr",
+  "rename",
+  "renameat",
+  "renameat2",
+  "request_key",
+  "restart_syscall",
+  "rmdir",
+  "rseq",
+  "rt_sigaction",
+  "rt_sigpending",
+  "rt_sigprocmask",
+  "rt_sigqueueinfo",
+  "rt_sigreturn",
+  "rt_sigsuspend",
+  "rt_sigtimedwait",
+  "rt_sigtimedwait_time64",
+  "rt_tgsigqueueinfo",
+  "sched_get_priority_max",
+  "sched_get_priority_min",
+  "sched_getaffinity",
+  "sched_getattr",
+  "sched_getparam",
+  "sched_getscheduler",
+  "sched_rr_get_interval",
+  "sched_rr_get_interval_time64",
+  "sched_setaffinity",
+  "sched_setattr",
+  "sched_setparam",
+  "sched_setscheduler",
+  "sched_yield",
+  "seccomp",
+  "security",
+  "select",
+  "semctl",
+  "semget",
+  "semop",
+  "semtimedop",
+  "semtimedop_time64",
+  "sendfile",
+  "sendfile64",
+  "sendmmsg",
+  "sendmsg",
+  "sendto",
+  "set_mempolicy",
+  "set_mempolicy_home_node",
+  "set_robust_list",
+  "set_thread_area",
+  "set_tid_address",
+  "setdomainname",
+  "setfsgid",
+  "setfsgid32",
+  "setfsuid",
+  "setfsuid32",
+  "setgid",
+  "setgid32",
+  "setgroups",
+  "setgroups32",
+  "sethostname",
+  "setitimer",
+  "setns",
+  "setpgid",
+  "setpriority",
+  "setregid",
+  "setregid32",
+  "setresgid",
+  "setresgid32",
+  "setresuid",
+  "setresuid32",
+  "setreuid",
+  "setreuid32",
+  "setrlimit",
+  "setsid",
+  "setsockopt",
+  "settimeofday",
+  "setuid",
+  "setuid32",
+  "setxattr",
+  "sgetmask",
+  "shmat",
+  "shmctl",
+  "shmdt",
+  "shmget",
+  "shutdown",
+  "sigaction",
+  "sigaltstack",
+  "signal",
+  "signalfd",
+  "signalfd4",
+  "sigpending",
+  "sigprocmask",
+  "sigreturn",
+  "sigsuspend",
+  "socket",
+  "socketcall",
+  "socketpair",
+  "splice",
+  "ssetmask",
+  "stat",
+  "stat64",
+  "statfs",
+  "statfs64",
+  "statx",
+  "stime",
+  "stty",
+  "swapoff",
+  "swapon",
+  "symlink",
+  "symlinkat",
+  "sync",
+  "sync_file_range",
+  "syncfs",
+  "sysfs",
+  "sysinfo",
+  "syslog",
+  "tee",
+  "tgkill",
+  "time",
+  "timer_create",
+  "timer_delete",
+  "timer_getoverrun",
+  "timer_gettime",
+  "timer_gettime64",
+  "timer_settime",
+  "timer_settime64",
+  "timerfd_create",
+  "timerfd_gettime",
+  "timerfd_gettime64",
+  "timerfd_settime",
+  "timerfd_settime64",
+  "times",
+  "tkill",
+  "truncate",
+  "truncate64",
+  "tuxcall",
+  "ugetrlimit",
+  "ulimit",
+  "umask",
+  "umount",
+  "umount2",
+  "uname",
+  "unlink",
+  "unlinkat",
+  "unshare",
+  "uselib",
+  "userfaultfd",
+  "ustat",
+  "utime",
+  "utimensat",
+  "utimensat_time64",
+  "utimes",
+  "vfork",
+  "vhangup",
+  "vm86",
+  "vm86old",
+  "vmsplice",
+  "vserver",
+  "wait4",
+  "waitid",
+  "waitpid",
+  "write",
+  "writev",
+};
+
+// x86_64 syscall numbers to indexes into syscall_names, plus one;
+// 0 where the number is unused
+static const short syscall_x86_64[] = {
+  [0] = 277, // read
+  [1] = 448, // write
+  [2] = 236, // open
+  [3] = 37, // close
+  [4] = 386, // stat
+  [5] = 88, // fstat
+  [6] = 184, // lstat
+  [7] = 253, // poll
+  [8] = 182, // lseek
+  [9] = 200, // mmap
+  [10] = 207, // mprotect
+  [11] = 225, // munmap
+  [12] = 17, // brk
+  [13] = 297, // rt_sigaction
+  [14] = 299, // rt_sigprocmask
+  [15] = 301, // rt_sigreturn
+  [16] = 157, // ioctl
+  [17] = 257, // pread64
+  [18] = 271, // pwrite64
+  [19] = 282, // readv
+  [20] = 449, // writev
+  [21] = 6, // access
+  [22] = 247, // pipe
+  [23] = 321, // select
+  [24] = 318, // sched_yield
+  [25] = 217, // mremap
+  [26] = 222, // msync
+  [27] = 192, // mincore
+  [28] = 186, // madvise
+  [29] = 370, // shmget
+  [30] = 367, // shmat
+  [31] = 368, // shmctl
+  [32] = 44, // dup
+  [33] = 45, // dup2
+  [34] = 241, // pause
+  [35] = 227, // nanosleep
+  [36] = 117, // getitimer
+  [37] = 11, // alarm
+  [38] = 347, // setitimer
+  [39] = 121, // getpid
+  [40] = 327, // sendfile
+  [41] = 381, // socket
+  [42] = 39, // connect
+  [43] = 4, // accept
+  [44] = 331, // sendto
+  [45] = 284, // recvfrom
+  [46] = 330, // sendmsg
+  [47] = 287, // recvmsg
+  [48] = 371, // shutdown
+  [49] = 14, // bind
+  [50] = 176, // listen
+  [51] = 133, // getsockname
+  [52] = 118, // getpeername
+  [53] = 383, // socketpair
+  [54] = 361, // setsockopt
+  [55] = 134, // getsockopt
+  [56] = 35, // clone
+  [57] = 81, // fork
+  [58] = 439, // vfork
+  [59] = 57, // execve
+  [60] = 59, // exit
+  [61] = 445, // wait4
+  [62] = 167, // kill
+  [63] = 428, // uname
+  [64] = 323, // semget
+  [65] = 324, // semop
+  [66] = 322, // semctl
+  [67] = 369, // shmdt
+  [68] = 219, // msgget
+  [69] = 221, // msgsnd
+  [70] = 220, // msgrcv
+  [71] = 218, // msgctl
+  [72] = 74, // fcntl
+  [73] = 80, // flock
+  [74] = 93, // fsync
+  [75] = 76, // fdatasync
+  [76] = 420, // truncate
+  [77] = 95, // ftruncate
+  [78] = 107, // getdents
+  [79] = 106, // getcwd
+  [80] = 20, // chdir
+  [81] = 68, // fchdir
+  [82] = 290, // rename
+  [83] = 193, // mkdir
+  [84] = 295, // rmdir
+  [85] = 41, // creat
+  [86] = 174, // link
+  [87] = 429, // unlink
+  [88] = 395, // symlink
+  [89] = 280, // readlink
+  [90] = 21, // chmod
+  [91] = 69, // fchmod
+  [92] = 22, // chown
+  [93] = 71, // fchown
+  [94] = 171, // lchown
+  [95] = 425, // umask
+  [96] = 136, // gettimeofday
+  [97] = 130, // getrlimit
+  [98] = 131, // getrusage
+  [99] = 401, // sysinfo
+  [100] = 418, // times
+  [101] = 269, // ptrace
+  [102] = 137, // getuid
+  [103] = 402, // syslog
+  [104] = 113, // getgid
+  [105] = 363, // setuid
+  [106] = 342, // setgid
+  [107] = 111, // geteuid
+  [108] = 109, // getegid
+  [109] = 349, // setpgid
+  [110] = 123, // getppid
+  [111] = 120, // getpgrp
+  [112] = 360, // setsid
+  [113] = 357, // setreuid
+  [114] = 351, // setregid
+  [115] = 115, // getgroups
+  [116] = 344, // setgroups
+  [117] = 355, // setresuid
+  [118] = 128, // getresuid
+  [119] = 353, // setresgid
+  [120] = 126, // getresgid
+  [121] = 119, // getpgid
+  [122] = 340, // setfsuid
+  [123] = 338, // setfsgid
+  [124] = 132, // getsid
+  [125] = 18, // capget
+  [126] = 19, // capset
+  [127] = 298, // rt_sigpending
+  [128] = 303, // rt_sigtimedwait
+  [129] = 300, // rt_sigqueueinfo
+  [130] = 302, // rt_sigsuspend
+  [131] = 373, // sigaltstack
+  [132] = 435, // utime
+  [133] = 195, // mknod
+  [134] = 432, // uselib
+  [135] = 243, // personality
+  [136] = 434, // ustat
+  [137] = 388, // statfs
+  [138] = 91, // fstatfs
+  [139] = 400, // sysfs
+  [140] = 124, // getpriority
+  [141] = 350, // setpriority
+  [142] = 316, // sched_setparam
+  [143] = 310, // sched_getparam
+  [144] = 317, // sched_setscheduler
+  [145] = 311, // sched_getscheduler
+  [146] = 306, // sched_get_priority_max
+  [147] = 307, // sched_get_priority_min
+  [148] = 312, // sched_rr_get_interval
+  [149] = 197, // mlock
+  [150] = 223, // munlock
+  [151] = 199, // mlockall
+  [152] = 224, // munlockall
+  [153] = 440, // vhangup
+  [154] = 202, // modify_ldt
+  [155] = 249, // pivot_root
+  [156] = 3, // _sysctl
+  [157] = 256, // prctl
+  [158] = 12, // arch_prctl
+  [159] = 9, // adjtimex
+  [160] = 359, // setrlimit
+  [161] = 24, // chroot
+  [162] = 397, // sync
+  [163] = 7, // acct
+  [164] = 362, // settimeofday
+  [165] = 203, // mount
+  [166] = 427, // umount2
+  [167] = 394, // swapon
+  [168] = 393, // swapoff
+  [169] = 283, // reboot
+  [170] = 346, // sethostname
+  [171] = 337, // setdomainname
+  [172] = 159, // iopl
+  [173] = 158, // ioperm
+  [174] = 42, // create_module
+  [175] = 142, // init_module
+  [176] = 43, // delete_module
+  [177] = 101, // get_kernel_syms
+  [178] = 274, // query_module
+  [179] = 275, // quotactl
+  [180] = 229, // nfsservctl
+  [181] = 122, // getpmsg
+  [182] = 270, // putpmsg
+  [183] = 10, // afs_syscall
+  [184] = 422, // tuxcall
+  [185] = 320, // security
+  [186] = 135, // gettid
+  [187] = 278, // readahead
+  [188] = 365, // setxattr
+  [189] = 183, // lsetxattr
+  [190] = 84, // fsetxattr
+  [191] = 139, // getxattr
+  [192] = 173, // lgetxattr
+  [193] = 77, // fgetxattr
+  [194] = 177, // listxattr
+  [195] = 178, // llistxattr
+  [196] = 79, // flistxattr
+  [197] = 289, // removexattr
+  [198] = 181, // lremovexattr
+  [199] = 82, // fremovexattr
+  [200] = 419, // tkill
+  [201] = 405, // time
+  [202] = 97, // futex
+  [203] = 314, // sched_setaffinity
+  [204] = 308, // sched_getaffinity
+  [205] = 335, // set_thread_area
+  [206] = 152, // io_setup
+  [207] = 148, // io_destroy
+  [208] = 149, // io_getevents
+  [209] = 153, // io_submit
+  [210] = 147, // io_cancel
+  [211] = 104, // get_thread_area
+  [212] = 180, // lookup_dcookie
+  [213] = 47, // epoll_create
+  [214] = 50, // epoll_ctl_old
+  [215] = 54, // epoll_wait_old
+  [216] = 288, // remap_file_pages
+  [217] = 108, // getdents64
+  [218] = 336, // set_tid_address
+  [219] = 294, // restart_syscall
+  [220] = 325, // semtimedop
+  [221] = 63, // fadvise64
+  [222] = 406, // timer_create
+  [223] = 411, // timer_settime
+  [224] = 409, // timer_gettime
+  [225] = 408, // timer_getoverrun
+  [226] = 407, // timer_delete
+  [227] = 33, // clock_settime
+  [228] = 29, // clock_gettime
+  [229] = 27, // clock_getres
+  [230] = 31, // clock_nanosleep
+  [231] = 60, // exit_group
+  [232] = 53, // epoll_wait
+  [233] = 49, // epoll_ctl
+  [234] = 404, // tgkill
+  [235] = 438, // utimes
+  [236] = 444, // vserver
+  [237] = 187, // mbind
+  [238] = 332, // set_mempolicy
+  [239] = 102, // get_mempolicy
+  [240] = 211, // mq_open
+  [241] = 216, // mq_unlink
+  [242] = 214, // mq_timedsend
+  [243] = 212, // mq_timedreceive
+  [244] = 210, // mq_notify
+  [245] = 209, // mq_getsetattr
+  [246] = 165, // kexec_load
+  [247] = 446, // waitid
+  [248] = 8, // add_key
+  [249] = 293, // request_key
+  [250] = 166, // keyctl
+  [251] = 161, // ioprio_set
+  [252] = 160, // ioprio_get
+  [253] = 144, // inotify_init
+  [254] = 143, // inotify_add_watch
+  [255] = 146, // inotify_rm_watch
+  [256] = 191, // migrate_pages
+  [257] = 239, // openat
+  [258] = 194, // mkdirat
+  [259] = 196, // mknodat
+  [260] = 73, // fchownat
+  [261] = 100, // futimesat
+  [262] = 228, // newfstatat
+  [263] = 430, // unlinkat
+  [264] = 291, // renameat
+  [265] = 175, // linkat
+  [266] = 396, // symlinkat
+  [267] = 281, // readlinkat
+  [268] = 70, // fchmodat
+  [269] = 61, // faccessat
+  [270] = 267, // pselect6
+  [271] = 254, // ppoll
+  [272] = 431, // unshare
+  [273] = 334, // set_robust_list
+  [274] = 103, // get_robust_list
+  [275] = 384, // splice
+  [276] = 403, // tee
+  [277] = 398, // sync_file_range
+  [278] = 443, // vmsplice
+  [279] = 206, // move_pages
+  [280] = 436, // utimensat
+  [281] = 51, // epoll_pwait
+  [282] = 375, // signalfd
+  [283] = 413, // timerfd_create
+  [284] = 55, // eventfd
+  [285] = 65, // fallocate
+  [286] = 416, // timerfd_settime
+  [287] = 414, // timerfd_gettime
+  [288] = 5, // accept4
+  [289] = 376, // signalfd4
+  [290] = 56, // eventfd2
+  [291] = 48, // epoll_create1
+  [292] = 46, // dup3
+  [293] = 248, // pipe2
+  [294] = 145, // inotify_init1
+  [295] = 258, // preadv
+  [296] = 272, // pwritev
+  [297] = 305, // rt_tgsigqueueinfo
+  [298] = 242, // perf_event_open
+  [299] = 285, // recvmmsg
+  [300] = 66, // fanotify_init
+  [301] = 67, // fanotify_mark
+  [302] = 260, // prlimit64
+  [303] = 226, // name_to_handle_at
+  [304] = 237, // open_by_handle_at
+  [305] = 25, // clock_adjtime
+  [306] = 399, // syncfs
+  [307] = 329, // sendmmsg
+  [308] = 348, // setns
+  [309] = 105, // getcpu
+  [310] = 263, // process_vm_readv
+  [311] = 264, // process_vm_writev
+  [312] = 163, // kcmp
+  [313] = 78, // finit_module
+  [314] = 315, // sched_setattr
+  [315] = 309, // sched_getattr
+  [316] = 292, // renameat2
+  [317] = 319, // seccomp
+  [318] = 125, // getrandom
+  [319] = 189, // memfd_create
+  [320] = 164, // kexec_file_load
+  [321] = 15, // bpf
+  [322] = 58, // execveat
+  [323] = 433, // userfaultfd
+  [324] = 188, // membarrier
+  [325] = 198, // mlock2
+  [326] = 40, // copy_file_range
+  [327] = 259, // preadv2
+  [328] = 273, // pwritev2
+  [329] = 252, // pkey_mprotect
+  [330] = 250, // pkey_alloc
+  [331] = 251, // pkey_free
+  [332] = 390, // statx
+  [333] = 150, // io_pgetevents
+  [334] = 296, // rseq
+  [424] = 246, // pidfd_send_signal
+  [425] = 156, // io_uring_setup
+  [426] = 154, // io_uring_enter
+  [427] = 155, // io_uring_register
+  [428] = 238, // open_tree
+  [429] = 205, // move_mount
+  [430] = 86, // fsopen
+  [431] = 83, // fsconfig
+  [432] = 85, // fsmount
+  [433] = 87, // fspick
+  [434] = 245, // pidfd_open
+  [435] = 36, // clone3
+  [436] = 38, // close_range
+  [437] = 240, // openat2
+  [438] = 244, // pidfd_getfd
+  [439] = 62, // faccessat2
+  [440] = 261, // process_madvise
+  [441] = 52, // epoll_pwait2
+  [442] = 204, // mount_setattr
+  [443] = 276, // quotactl_fd
+  [444] = 169, // landlock_create_ruleset
+  [445] = 168, // landlock_add_rule
+  [446] = 170, // landlock_restrict_self
+  [447] = 190, // memfd_secret
+  [448] = 262, // process_mrelease
+  [449] = 99, // futex_waitv
+  [450] = 333, // set_mempolicy_home_node
+};
+
+// i386 syscall numbers to indexes into syscall_names, plus one;
+// 0 where the number is unused
+static const short syscall_i386[] = {
+  [0] = 294, // restart_syscall
+  [1] = 59, // exit
+  [2] = 81, // fork
+  [3] = 277, // read
+  [4] = 448, // write
+  [5] = 236, // open
+  [6] = 37, // close
+  [7] = 447, // waitpid
+  [8] = 41, // creat
+  [9] = 174, // link
+  [10] = 429, // unlink
+  [11] = 57, // execve
+  [12] = 20, // chdir
+  [13] = 405, // time
+  [14] = 195, // mknod
+  [15] = 21, // chmod
+  [16] = 171, // lchown
+  [17] = 16, // break
+  [18] = 234, // oldstat
+  [19] = 182, // lseek
+  [20] = 121, // getpid
+  [21] = 203, // mount
+  [22] = 426, // umount
+  [23] = 363, // setuid
+  [24] = 137, // getuid
+  [25] = 391, // stime
+  [26] = 269, // ptrace
+  [27] = 11, // alarm
+  [28] = 231, // oldfstat
+  [29] = 241, // pause
+  [30] = 435, // utime
+  [31] = 392, // stty
+  [32] = 140, // gtty
+  [33] = 6, // access
+  [34] = 230, // nice
+  [35] = 94, // ftime
+  [36] = 397, // sync
+  [37] = 167, // kill
+  [38] = 290, // rename
+  [39] = 193, // mkdir
+  [40] = 295, // rmdir
+  [41] = 44, // dup
+  [42] = 247, // pipe
+  [43] = 418, // times
+  [44] = 265, // prof
+  [45] = 17, // brk
+  [46] = 342, // setgid
+  [47] = 113, // getgid
+  [48] = 374, // signal
+  [49] = 111, // geteuid
+  [50] = 109, // getegid
+  [51] = 7, // acct
+  [52] = 427, // umount2
+  [53] = 179, // lock
+  [54] = 157, // ioctl
+  [55] = 74, // fcntl
+  [56] = 208, // mpx
+  [57] = 349, // setpgid
+  [58] = 424, // ulimit
+  [59] = 233, // oldolduname
+  [60] = 425, // umask
+  [61] = 24, // chroot
+  [62] = 434, // ustat
+  [63] = 45, // dup2
+  [64] = 123, // getppid
+  [65] = 120, // getpgrp
+  [66] = 360, // setsid
+  [67] = 372, // sigaction
+  [68] = 366, // sgetmask
+  [69] = 385, // ssetmask
+  [70] = 357, // setreuid
+  [71] = 351, // setregid
+  [72] = 380, // sigsuspend
+  [73] = 377, // sigpending
+  [74] = 346, // sethostname
+  [75] = 359, // setrlimit
+  [76] = 130, // getrlimit
+  [77] = 131, // getrusage
+  [78] = 136, // gettimeofday
+  [79] = 362, // settimeofday
+  [80] = 115, // getgroups
+  [81] = 344, // setgroups
+  [82] = 321, // select
+  [83] = 395, // symlink
+  [84] = 232, // oldlstat
+  [85] = 280, // readlink
+  [86] = 432, // uselib
+  [87] = 394, // swapon
+  [88] = 283, // reboot
+  [89] = 279, // readdir
+  [90] = 200, // mmap
+  [91] = 225, // munmap
+  [92] = 420, // truncate
+  [93] = 95, // ftruncate
+  [94] = 69, // fchmod
+  [95] = 71, // fchown
+  [96] = 124, // getpriority
+  [97] = 350, // setpriority
+  [98] = 266, // profil
+  [99] = 388, // statfs
+  [100] = 91, // fstatfs
+  [101] = 158, // ioperm
+  [102] = 382, // socketcall
+  [103] = 402, // syslog
+  [104] = 347, // setitimer
+  [105] = 117, // getitimer
+  [106] = 386, // stat
+  [107] = 184, // lstat
+  [108] = 88, // fstat
+  [109] = 235, // olduname
+  [110] = 159, // iopl
+  [111] = 440, // vhangup
+  [112] = 141, // idle
+  [113] = 442, // vm86old
+  [114] = 445, // wait4
+  [115] = 393, // swapoff
+  [116] = 401, // sysinfo
+  [117] = 162, // ipc
+  [118] = 93, // fsync
+  [119] = 379, // sigreturn
+  [120] = 35, // clone
+  [121] = 337, // setdomainname
+  [122] = 428, // uname
+  [123] = 202, // modify_ldt
+  [124] = 9, // adjtimex
+  [125] = 207, // mprotect
+  [126] = 378, // sigprocmask
+  [127] = 42, // create_module
+  [128] = 142, // init_module
+  [129] = 43, // delete_module
+  [130] = 101, // get_kernel_syms
+  [131] = 275, // quotactl
+  [132] = 119, // getpgid
+  [133] = 68, // fchdir
+  [134] = 13, // bdflush
+  [135] = 400, // sysfs
+  [136] = 243, // personality
+  [137] = 10, // afs_syscall
+  [138] = 340, // setfsuid
+  [139] = 338, // setfsgid
+  [140] = 1, // _llseek
+  [141] = 107, // getdents
+  [142] = 2, // _newselect
+  [143] = 80, // flock
+  [144] = 222, // msync
+  [145] = 282, // readv
+  [146] = 449, // writev
+  [147] = 132, // getsid
+  [148] = 76, // fdatasync
+  [149] = 3, // _sysctl
+  [150] = 197, // mlock
+  [151] = 223, // munlock
+  [152] = 199, // mlockall
+  [153] = 224, // munlockall
+  [154] = 316, // sched_setparam
+  [155] = 310, // sched_getparam
+  [156] = 317, // sched_setscheduler
+  [157] = 311, // sched_getscheduler
+  [158] = 318, // sched_yield
+  [159] = 306, // sched_get_priority_max
+  [160] = 307, // sched_get_priority_min
+  [161] = 312, // sched_rr_get_interval
+  [162] = 227, // nanosleep
+  [163] = 217, // mremap
+  [164] = 355, // setresuid
+  [165] = 128, // getresuid
+  [166] = 441, // vm86
+  [167] = 274, // query_module
+  [168] = 253, // poll
+  [169] = 229, // nfsservctl
+  [170] = 353, // setresgid
+  [171] = 126, // getresgid
+  [172] = 256, // prctl
+  [173] = 301, // rt_sigreturn
+  [174] = 297, // rt_sigaction
+  [175] = 299, // rt_sigprocmask
+  [176] = 298, // rt_sigpending
+  [177] = 303, // rt_sigtimedwait
+  [178] = 300, // rt_sigqueueinfo
+  [179] = 302, // rt_sigsuspend
+  [180] = 257, // pread64
+  [181] = 271, // pwrite64
+  [182] = 22, // chown
+  [183] = 106, // getcwd
+  [184] = 18, // capget
+  [185] = 19, // capset
+  [186] = 373, // sigaltstack
+  [187] = 327, // sendfile
+  [188] = 122, // getpmsg
+  [189] = 270, // putpmsg
+  [190] = 439, // vfork
+  [191] = 423, // ugetrlimit
+  [192] = 201, // mmap2
+  [193] = 421, // truncate64
+  [194] = 96, // ftruncate64
+  [195] = 387, // stat64
+  [196] = 185, // lstat64
+  [197] = 89, // fstat64
+  [198] = 172, // lchown32
+  [199] = 138, // getuid32
+  [200] = 114, // getgid32
+  [201] = 112, // geteuid32
+  [202] = 110, // getegid32
+  [203] = 358, // setreuid32
+  [204] = 352, // setregid32
+  [205] = 116, // getgroups32
+  [206] = 345, // setgroups32
+  [207] = 72, // fchown32
+  [208] = 356, // setresuid32
+  [209] = 129, // getresuid32
+  [210] = 354, // setresgid32
+  [211] = 127, // getresgid32
+  [212] = 23, // chown32
+  [213] = 364, // setuid32
+  [214] = 343, // setgid32
+  [215] = 341, // setfsuid32
+  [216] = 339, // setfsgid32
+  [217] = 249, // pivot_root
+  [218] = 192, // mincore
+  [219] = 186, // madvise
+  [220] = 108, // getdents64
+  [221] = 75, // fcntl64
+  [224] = 135, // gettid
+  [225] = 278, // readahead
+  [226] = 365, // setxattr
+  [227] = 183, // lsetxattr
+  [228] = 84, // fsetxattr
+  [229] = 139, // getxattr
+  [230] = 173, // lgetxattr
+  [231] = 77, // fgetxattr
+  [232] = 177, // listxattr
+  [233] = 178, // llistxattr
+  [234] = 79, // flistxattr
+  [235] = 289, // removexattr
+  [236] = 181, // lremovexattr
+  [237] = 82, // fremovexattr
+  [238] = 419, // tkill
+  [239] = 328, // sendfile64
+  [240] = 97, // futex
+  [241] = 314, // sched_setaffinity
+  [242] = 308, // sched_getaffinity
+  [243] = 335, // set_thread_area
+  [244] = 104, // get_thread_area
+  [245] = 152, // io_setup
+  [246] = 148, // io_destroy
+  [247] = 149, // io_getevents
+  [248] = 153, // io_submit
+  [249] = 147, // io_cancel
+  [250] = 63, // fadvise64
+  [252] = 60, // exit_group
+  [253] = 180, // lookup_dcookie
+  [254] = 47, // epoll_create
+  [255] = 49, // epoll_ctl
+  [256] = 53, // epoll_wait
+  [257] = 288, // remap_file_pages
+  [258] = 336, // set_tid_address
+  [259] = 406, // timer_create
+  [260] = 411, // timer_settime
+  [261] = 409, // timer_gettime
+  [262] = 408, // timer_getoverrun
+  [263] = 407, // timer_delete
+  [264] = 33, // clock_settime
+  [265] = 29, // clock_gettime
+  [266] = 27, // clock_getres
+  [267] = 31, // clock_nanosleep
+  [268] = 389, // statfs64
+  [269] = 92, // fstatfs64
+  [270] = 404, // tgkill
+  [271] = 438, // utimes
+  [272] = 64, // fadvise64_64
+  [273] = 444, // vserver
+  [274] = 187, // mbind
+  [275] = 102, // get_mempolicy
+  [276] = 332, // set_mempolicy
+  [277] = 211, // mq_open
+  [278] = 216, // mq_unlink
+  [279] = 214, // mq_timedsend
+  [280] = 212, // mq_timedreceive
+  [281] = 210, // mq_notify
+  [282] = 209, // mq_getsetattr
+  [283] = 165, // kexec_load
+  [284] = 446, // waitid
+  [286] = 8, // add_key
+  [287] = 293, // request_key
+  [288] = 166, // keyctl
+  [289] = 161, // ioprio_set
+  [290] = 160, // ioprio_get
+  [291] = 144, // inotify_init
+  [292] = 143, // inotify_add_watch
+  [293] = 146, // inotify_rm_watch
+  [294] = 191, // migrate_pages
+  [295] = 239, // openat
+  [296] = 194, // mkdirat
+  [297] = 196, // mknodat
+  [298] = 73, // fchownat
+  [299] = 100, // futimesat
+  [300] = 90, // fstatat64
+  [301] = 430, // unlinkat
+  [302] = 291, // renameat
+  [303] = 175, // linkat
+  [304] = 396, // symlinkat
+  [305] = 281, // readlinkat
+  [306] = 70, // fchmodat
+  [307] = 61, // faccessat
+  [308] = 267, // pselect6
+  [309] = 254, // ppoll
+  [310] = 431, // unshare
+  [311] = 334, // set_robust_list
+  [312] = 103, // get_robust_list
+  [313] = 384, // splice
+  [314] = 398, // sync_file_range
+  [315] = 403, // tee
+  [316] = 443, // vmsplice
+  [317] = 206, // move_pages
+  [318] = 105, // getcpu
+  [319] = 51, // epoll_pwait
+  [320] = 436, // utimensat
+  [321] = 375, // signalfd
+  [322] = 413, // timerfd_create
+  [323] = 55, // eventfd
+  [324] = 65, // fallocate
+  [325] = 416, // timerfd_settime
+  [326] = 414, // timerfd_gettime
+  [327] = 376, // signalfd4
+  [328] = 56, // eventfd2
+  [329] = 48, // epoll_create1
+  [330] = 46, // dup3
+  [331] = 248, // pipe2
+  [332] = 145, // inotify_init1
+  [333] = 258, // preadv
+  [334] = 272, // pwritev
+  [335] = 305, // rt_tgsigqueueinfo
+  [336] = 242, // perf_event_open
+  [337] = 285, // recvmmsg
+  [338] = 66, // fanotify_init
+  [339] = 67, // fanotify_mark
+  [340] = 260, // prlimit64
+  [341] = 226, // name_to_handle_at
+  [342] = 237, // open_by_handle_at
+  [343] = 25, // clock_adjtime
+  [344] = 399, // syncfs
+  [345] = 329, // sendmmsg
+  [346] = 348, // setns
+  [347] = 263, // process_vm_readv
+  [348] = 264, // process_vm_writev
+  [349] = 163, // kcmp
+  [350] = 78, // finit_module
+  [351] = 315, // sched_setattr
+  [352] = 309, // sched_getattr
+  [353] = 292, // renameat2
+  [354] = 319, // seccomp
+  [355] = 125, // getrandom
+  [356] = 189, // memfd_create
+  [357] = 15, // bpf
+  [358] = 58, // execveat
+  [359] = 381, // socket
+  [360] = 383, // socketpair
+  [361] = 14, // bind
+  [362] = 39, // connect
+  [363] = 176, // listen
+  [364] = 5, // accept4
+  [365] = 134, // getsockopt
+  [366] = 361, // setsockopt
+  [367] = 133, // getsockname
+  [368] = 118, // getpeername
+  [369] = 331, // sendto
+  [370] = 330, // sendmsg
+  [371] = 284, // recvfrom
+  [372] = 287, // recvmsg
+  [373] = 371, // shutdown
+  [374] = 433, // userfaultfd
+  [375] = 188, // membarrier
+  [376] = 198, // mlock2
+  [377] = 40, // copy_file_range
+  [378] = 259, // preadv2
+  [379] = 273, // pwritev2
+  [380] = 252, // pkey_mprotect
+  [381] = 250, // pkey_alloc
+  [382] = 251, // pkey_free
+  [383] = 390, // statx
+  [384] = 12, // arch_prctl
+  [385] = 150, // io_pgetevents
+  [386] = 296, // rseq
+  [393] = 323, // semget
+  [394] = 322, // semctl
+  [395] = 370, // shmget
+  [396] = 368, // shmctl
+  [397] = 367, // shmat
+  [398] = 369, // shmdt
+  [399] = 219, // msgget
+  [400] = 221, // msgsnd
+  [401] = 220, // msgrcv
+  [402] = 218, // msgctl
+  [403] = 30, // clock_gettime64
+  [404] = 34, // clock_settime64
+  [405] = 26, // clock_adjtime64
+  [406] = 28, // clock_getres_time64
+  [407] = 32, // clock_nanosleep_time64
+  [408] = 410, // timer_gettime64
+  [409] = 412, // timer_settime64
+  [410] = 415, // timerfd_gettime64
+  [411] = 417, // timerfd_settime64
+  [412] = 437, // utimensat_time64
+  [413] = 268, // pselect6_time64
+  [414] = 255, // ppoll_time64
+  [416] = 151, // io_pgetevents_time64
+  [417] = 286, // recvmmsg_time64
+  [418] = 215, // mq_timedsend_time64
+  [419] = 213, // mq_timedreceive_time64
+  [420] = 326, // semtimedop_time64
+  [421] = 304, // rt_sigtimedwait_time64
+  [422] = 98, // futex_time64
+  [423] = 313, // sched_rr_get_interval_time64
+  [424] = 246, // pidfd_send_signal
+  [425] = 156, // io_uring_setup
+  [426] = 154, // io_uring_enter
+  [427] = 155, // io_uring_register
+  [428] = 238, // open_tree
+  [429] = 205, // move_mount
+  [430] = 86, // fsopen
+  [431] = 83, // fsconfig
+  [432] = 85, // fsmount
+  [433] = 87, // fspick
+  [434] = 245, // pidfd_open
+  [435] = 36, // clone3
+  [436] = 38, // close_range
+  [437] = 240, // openat2
+  [438] = 244, // pidfd_getfd
+  [439] = 62, // faccessat2
+  [440] = 261, // process_madvise
+  [441] = 52, // epoll_pwait2
+  [442] = 204, // mount_setattr
+  [443] = 276, // quotactl_fd
+  [444] = 169, // landlock_create_ruleset
+  [445] = 168, // landlock_add_rule
+  [446] = 170, // landlock_restrict_self
+  [447] = 190, // memfd_secret
+  [448] = 262, // process_mrelease
+  [449] = 99, // futex_waitv
+  [450] = 333, // set_mempolicy_home_node
+};
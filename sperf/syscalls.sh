@@ -0,0 +1,43 @@
+#!/bin/sh
+# syscalls.h from the kernel headers: sh syscalls.sh [ASM_DIR] > syscalls.h
+# ASM_DIR holds unistd_64.h and unistd_32.h, as in linux-libc-dev
+dir=${1:-/usr/include/x86_64-linux-gnu/asm}
+export LC_ALL=C
+
+nrs() { # "name nr" for each __NR_ in $1
+  awk '$1 == "#define" && $2 ~ /^__NR_/ && $3 ~ /^[0-9]+$/ {
+    print substr($2, 6), $3 }' "$1"
+}
+
+{
+  nrs "$dir/unistd_64.h" | sed 's/^/64 /'
+  nrs "$dir/unistd_32.h" | sed 's/^/32 /'
+} | awk -v names="$(
+  { nrs "$dir/unistd_64.h"; nrs "$dir/unistd_32.h"; } | cut -d' ' -f1 | sort -u
+)" '
+BEGIN {
+  n = split(names, name, "\n")
+  for (i = 1; i <= n; ++i) index_of[name[i]] = i
+}
+{ abi[NR] = $1; sym[NR] = $2; nr[NR] = $3 }
+function table(bits, arch, i) {
+  print ""
+  print "// " arch " syscall numbers to indexes into syscall_names, plus one;"
+  print "// 0 where the number is unused"
+  print "static const short syscall_" arch "[] = {"
+  for (i = 1; i <= NR; ++i) {
+    if (abi[i] == bits) printf "  [%d] = %d, // %s\n", nr[i], index_of[sym[i]], sym[i]
+  }
+  print "};"
+}
+END {
+  print "// Generated by syscalls.sh from the x86-64 and i386 <asm/unistd_*.h>."
+  print "// The numbers depend on the tracee'"'"'s ABI, not the one sperf is built for."
+  print ""
+  print "// every syscall name of either ABI, sorted; sperf counts by index here"
+  print "static const char *syscall_names[] = {"
+  for (i = 1; i <= n; ++i) printf "  \"%s\",\n", name[i]
+  print "};"
+  table(64, "x86_64")
+  table(32, "i386")
+}'